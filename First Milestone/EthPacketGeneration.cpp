@@ -13,9 +13,31 @@
 #include <array>
 #include <vector>
 #include <cstdint>
+#include <cstring>
 #include <map>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+#include <functional>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_INTRINSICS 1
+#endif
 
 #define ETH_HEADER_SIZE 26
+#define HEX_EXPORT_BLOCK (1ULL << 20)   // Bytes formatted per write call by the hex exporter
+#define PCAPNG_WRITE_BLOCK (1ULL << 20) // Bytes of pcapng blocks buffered per write call
+#define RLE_MIN_IDLE_RUN 8              // Shortest IFG run stored as an idle record of an RLE container
+#define RLE_WRITE_BLOCK (1ULL << 20)    // Bytes of RLE records buffered per write call
+#define STREAM_CHUNK_SIZE (4ULL << 20)  // Bytes of the stream materialized at a time for the exporters
 using namespace std;
 
 // Converts a given number into an array of bytes, with the most significant byte at the lowest index.
@@ -32,12 +54,107 @@ array<uint8_t, my_size> intToArray(intType number)
     return result;
 }
 
+// CRC-32 engine used for the Ethernet Frame Check Sequence (reflected polynomial 0xEDB88320).
+// Same interface as the Second Milestone engine; only the slicing-by-16 tables are used here because
+// the stream repeats a single frame, so the FCS is computed once per run.
+class crc32Engine
+{
+public:
+    // Update a running CRC register (initial value 0xFFFFFFFF, not yet inverted) with the given bytes
+    static uint32_t update(uint32_t crc, const uint8_t *data, uint64_t length)
+    {
+        return updateTable(crc, data, length);
+    }
+
+    // Compute the final CRC-32 value of a buffer
+    static uint32_t compute(const uint8_t *data, uint64_t length)
+    {
+        return update(0xFFFFFFFF, data, length) ^ 0xFFFFFFFF;
+    }
+
+    // Table-driven update, usable on any CPU (slicing-by-16, then slicing-by-8, then byte at a time)
+    static uint32_t updateTable(uint32_t crc, const uint8_t *data, uint64_t length)
+    {
+        const auto &table = tables();
+
+        while (length >= 16)
+        {
+            uint32_t a = crc ^ load32(data);
+            uint32_t b = load32(data + 4);
+            uint32_t c = load32(data + 8);
+            uint32_t d = load32(data + 12);
+
+            crc = table[15][a & 0xFF] ^ table[14][(a >> 8) & 0xFF] ^ table[13][(a >> 16) & 0xFF] ^ table[12][a >> 24] ^
+                  table[11][b & 0xFF] ^ table[10][(b >> 8) & 0xFF] ^ table[9][(b >> 16) & 0xFF] ^ table[8][b >> 24] ^
+                  table[7][c & 0xFF] ^ table[6][(c >> 8) & 0xFF] ^ table[5][(c >> 16) & 0xFF] ^ table[4][c >> 24] ^
+                  table[3][d & 0xFF] ^ table[2][(d >> 8) & 0xFF] ^ table[1][(d >> 16) & 0xFF] ^ table[0][d >> 24];
+
+            data += 16;
+            length -= 16;
+        }
+
+        if (length >= 8)
+        {
+            uint32_t a = crc ^ load32(data);
+            uint32_t b = load32(data + 4);
+
+            crc = table[7][a & 0xFF] ^ table[6][(a >> 8) & 0xFF] ^ table[5][(a >> 16) & 0xFF] ^ table[4][a >> 24] ^
+                  table[3][b & 0xFF] ^ table[2][(b >> 8) & 0xFF] ^ table[1][(b >> 16) & 0xFF] ^ table[0][b >> 24];
+
+            data += 8;
+            length -= 8;
+        }
+
+        while (length--)
+        {
+            crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+        }
+
+        return crc;
+    }
+
+private:
+    // Slicing tables: table[0] is the classic byte table, table[k] advances a byte by k more positions
+    static const array<array<uint32_t, 256>, 16> &tables()
+    {
+        static const array<array<uint32_t, 256>, 16> table = []
+        {
+            array<array<uint32_t, 256>, 16> result{};
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+                }
+                result[0][i] = crc;
+            }
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                for (int k = 1; k < 16; k++)
+                {
+                    result[k][i] = (result[k - 1][i] >> 8) ^ result[0][result[k - 1][i] & 0xFF];
+                }
+            }
+            return result;
+        }();
+        return table;
+    }
+
+    // Little-endian 32-bit load that does not depend on host byte order or alignment
+    static uint32_t load32(const uint8_t *p)
+    {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+};
+
 class parseConfigurations
 {
 public:
     // Configuration parameters parsed from the file
-    uint8_t LineRate;              // Ethernet line rate (in Gbps)
-    uint8_t CaptureSizeMs;         // Capture duration in milliseconds
+    uint64_t LineRate;             // Ethernet line rate (in Gbps)
+    uint64_t CaptureSizeMs;        // Capture duration in milliseconds
     uint8_t MinNumOfIFGsPerPacket; // Minimum number of inter-frame gaps (IFGs) per packet
     uint64_t DestAddress;          // Destination MAC address
     uint64_t SourceAddress;        // Source MAC address
@@ -98,14 +215,14 @@ public:
         }
 
         // Set the configuration fields from the map values
-        LineRate = static_cast<uint8_t>(config["Eth.LineRate"]);
-        CaptureSizeMs = static_cast<uint8_t>(config["Eth.CaptureSizeMs"]);
+        LineRate = config["Eth.LineRate"];
+        CaptureSizeMs = config["Eth.CaptureSizeMs"];
         MinNumOfIFGsPerPacket = static_cast<uint8_t>(config["Eth.MinNumOfIFGsPerPacket"]);
         DestAddress = config["Eth.DestAddress"];
         SourceAddress = config["Eth.SourceAddress"];
         MaxPacketSize = static_cast<uint16_t>(config["Eth.MaxPacketSize"]);
         BurstSize = static_cast<uint8_t>(config["Eth.BurstSize"]);
-        BurstPeriodicity_us = static_cast<uint16_t>(config["Eth.BurstPeriodicity_us"]);
+        BurstPeriodicity_us = static_cast<uint32_t>(config["Eth.BurstPeriodicity_us"]);
 
         // Close the file
         MyReadFile.close();
@@ -146,25 +263,7 @@ public:
     // Method to calculate CRC-32 (Frame Check Sequence) for the given data
     array<uint8_t, 4> crc32(const vector<uint8_t> &data)
     {
-        uint32_t crc = 0xFFFFFFFF;              // Initial CRC value
-        const uint32_t polynomial = 0xEDB88320; // Polynomial used in Ethernet CRC-32
-
-        for (auto byte : data)
-        {
-            crc ^= static_cast<uint32_t>(byte); // XOR byte with current CRC value
-            for (int i = 0; i < 8; ++i)
-            {
-                if (crc & 1)
-                {
-                    crc = (crc >> 1) ^ polynomial;
-                }
-                else
-                {
-                    crc >>= 1;
-                }
-            }
-        }
-        crc = crc ^ 0xFFFFFFFF; // Final XOR to complete the CRC
+        uint32_t crc = crc32Engine::compute(data.data(), data.size());
 
         // Convert the 32-bit CRC result to a 4-byte array
         array<uint8_t, 4> crcArray;
@@ -214,15 +313,124 @@ public:
     }
 };
 
-class packetStreaming
+// Compact description of a stream: a few frame templates and a list of entries, each repeating `bursts`
+// times a burst of `frames` copies of one template followed by `idleBytes` IFG bytes. The description is
+// all that sizing, planning and statistics need. The bytes are only produced when an exporter asks for
+// them, one range at a time, so the memory use does not depend on the capture length.
+class streamDescriptor
 {
+public:
+    struct entry
+    {
+        uint32_t frameTemplate; // Index of the frame (preamble through trailing IFGs) among the templates
+        uint64_t frames;        // Copies of the frame in each burst
+        uint64_t idleBytes;     // IFG bytes after the frames of each burst
+        uint64_t bursts;        // Repetitions of the burst
+
+        uint64_t burstBytes(uint64_t frameBytes) const { return frames * frameBytes + idleBytes; }
+    };
+
 private:
-    // Full packet stream, including bursts and periodic IFGs
-    vector<uint8_t> fullPacket;
+    vector<vector<uint8_t>> templates;
+    vector<entry> entries;
+
+public:
+    uint32_t addTemplate(vector<uint8_t> frame)
+    {
+        templates.push_back(move(frame));
+        return static_cast<uint32_t>(templates.size() - 1);
+    }
+
+    // Append `bursts` bursts; a burst identical to the previous entry's only increments its count
+    void append(uint32_t frameTemplate, uint64_t frames, uint64_t idleBytes, uint64_t bursts = 1)
+    {
+        if (!entries.empty() && entries.back().frameTemplate == frameTemplate && entries.back().frames == frames &&
+            entries.back().idleBytes == idleBytes)
+        {
+            entries.back().bursts += bursts;
+            return;
+        }
+        entries.push_back({frameTemplate, frames, idleBytes, bursts});
+    }
+
+    uint64_t size() const
+    {
+        uint64_t bytes = 0;
+        for (const entry &e : entries)
+        {
+            bytes += e.bursts * e.burstBytes(templates[e.frameTemplate].size());
+        }
+        return bytes;
+    }
+
+    uint64_t frameCount() const
+    {
+        uint64_t frames = 0;
+        for (const entry &e : entries)
+        {
+            frames += e.bursts * e.frames;
+        }
+        return frames;
+    }
+
+    const vector<entry> &getEntries() const { return entries; }
+    const vector<uint8_t> &getTemplate(uint32_t index) const { return templates[index]; }
+
+    // Write the bytes [offset, offset + length) of the stream to `destination`
+    void materialize(uint64_t offset, uint64_t length, uint8_t *destination) const
+    {
+        uint64_t start = 0; // Stream offset of the current entry
+        for (const entry &e : entries)
+        {
+            const vector<uint8_t> &frame = templates[e.frameTemplate];
+            uint64_t framesBytes = e.frames * frame.size();
+            uint64_t burstBytes = e.burstBytes(frame.size());
+            uint64_t end = start + e.bursts * burstBytes;
+            while (length > 0 && offset < end)
+            {
+                uint64_t inBurst = (offset - start) % burstBytes;
+                uint64_t take;
+                if (inBurst < framesBytes)
+                {
+                    uint64_t inFrame = inBurst % frame.size();
+                    take = min(length, frame.size() - inFrame);
+                    memcpy(destination, frame.data() + inFrame, take);
+                }
+                else
+                {
+                    take = min(length, burstBytes - inBurst);
+                    memset(destination, 0x07, take);
+                }
+                destination += take;
+                offset += take;
+                length -= take;
+            }
+            if (length == 0)
+            {
+                return;
+            }
+            start = end;
+        }
+        throw runtime_error("Stream range past the end of the stream");
+    }
 
-    // IFGs between bursts
-    vector<uint8_t> periodicIFG;
+    // Hand the whole stream to `consumer` in order, STREAM_CHUNK_SIZE bytes at a time
+    void forEachChunk(const function<void(const uint8_t *data, uint64_t length, uint64_t streamOffset)> &consumer) const
+    {
+        uint64_t total = size();
+        vector<uint8_t> chunk(min<uint64_t>(STREAM_CHUNK_SIZE, total));
+        for (uint64_t offset = 0; offset < total; offset += chunk.size())
+        {
+            uint64_t length = min<uint64_t>(chunk.size(), total - offset);
+            materialize(offset, length, chunk.data());
+            consumer(chunk.data(), length, offset);
+        }
+    }
+};
 
+class packetStreaming
+{
+private:
     // Ethernet frame details: destination MAC, source MAC, EtherType/Size, and payload
     array<uint8_t, 6> destAddress;
     array<uint8_t, 6> sourceAddress;
@@ -259,8 +467,9 @@ public:
         payload = data;
     }
 
-    // Method to construct the full stream of packets and IFGs
-    vector<uint8_t> constructStream()
+    // Method to describe the full stream of packets and IFGs. Every burst is the same, so the description
+    // is one template and one entry, built in constant time whatever the capture length.
+    streamDescriptor describeStream()
     {
         // Construct an Ethernet frame using the payload, source, and destination MAC addresses
         EthFrame burst{destAddress, sourceAddress, etherSize, payload};
@@ -276,88 +485,807 @@ public:
         uint64_t burstLength{totalTransmisson / totalBursts};
 
         // Calculate the number of IFG bytes per burst after accounting for the packet size
+        if (burstLength < burstSize * tempFrame.size())
+        {
+            throw runtime_error("Negative IFGs");
+        }
         uint64_t IFGperBurst{burstLength - (burstSize * tempFrame.size())};
 
-        // Fill periodic IFG with the calculated number of bytes (using IFG byte 0x07)
-        periodicIFG.assign(IFGperBurst, 0x07);
-
-        // Build the full packet stream
+        // Describe the full packet stream: burstSize frames then the periodic IFGs, totalBursts times
         cout << ".....Start generating the stream....." << endl;
-        for (uint64_t i = 0; i < totalBursts; i++)
+        streamDescriptor stream;
+        uint64_t frameSize = tempFrame.size();
+        stream.append(stream.addTemplate(move(tempFrame)), burstSize, IFGperBurst, totalBursts);
+
+        // Output the number of bytes in the described packet stream
+        cout << ".....Done generating....." << endl;
+        cout << "Total Bytes Generated: " << stream.size() << endl;
+        cout << "Total Bursts Generated: " << uint64_t(totalBursts) << endl;
+        cout << "Burst Size: " << uint64_t(burstSize) << endl;
+        cout << "Total Ethernet Frames: " << stream.frameCount() << endl;
+        cout << "Ethernet Frame Size (Including IFGs): " << frameSize << endl;
+
+        // Return the description; the bytes are produced when the stream is exported
+        return stream;
+    }
+};
+
+// Formats bytes in the packets.txt layout: 2 lowercase hex digits per byte, a line break after every 4 bytes.
+// Whole lines are formatted 16 bytes at a time with an SSSE3 nibble shuffle when the CPU supports it,
+// otherwise through a 256-entry table of digit pairs.
+class hexEncoder
+{
+public:
+    // Number of characters produced for `length` bytes when `counter` bytes are already on the current line
+    static uint64_t encodedSize(uint64_t length, uint8_t counter)
+    {
+        return 2 * length + (counter + length) / 4;
+    }
+
+    // Format `length` bytes into `out` and return the end of the written characters. `counter` holds the
+    // number of bytes already on the current line and is updated, so a stream can be encoded in pieces.
+    static char *encode(const uint8_t *data, uint64_t length, uint8_t &counter, char *out)
+    {
+        // Finish the current line byte by byte
+        while (length > 0 && counter != 0)
+        {
+            out = encodeByte(*data++, counter, out);
+            length--;
+        }
+
+        // Whole lines
+        uint64_t lines = length / 4;
+        out = kernel()(data, lines, out);
+        data += lines * 4;
+        length -= lines * 4;
+
+        // Start of a last, partial line
+        while (length-- > 0)
         {
-            // Insert burstSize number of packets in each burst
-            for (uint64_t i = 0; i < burstSize; i++)
+            out = encodeByte(*data++, counter, out);
+        }
+        return out;
+    }
+
+private:
+    static const array<uint16_t, 256> &digitPairs()
+    {
+        static const array<uint16_t, 256> table = []
+        {
+            const char *digits = "0123456789abcdef";
+            array<uint16_t, 256> result{};
+            for (int i = 0; i < 256; i++)
             {
-                fullPacket.insert(fullPacket.end(), tempFrame.begin(), tempFrame.end());
+                char pair[2] = {digits[i >> 4], digits[i & 0x0F]};
+                memcpy(&result[i], pair, 2);
             }
-            // Insert periodic IFG after each burst
-            fullPacket.insert(fullPacket.end(), periodicIFG.begin(), periodicIFG.end());
+            return result;
+        }();
+        return table;
+    }
+
+    static char *encodeByte(uint8_t byte, uint8_t &counter, char *out)
+    {
+        memcpy(out, &digitPairs()[byte], 2);
+        out += 2;
+        if (++counter == 4)
+        {
+            *out++ = '\n';
+            counter = 0;
         }
+        return out;
+    }
 
-        // Output the number of bytes in the generated packet stream
-        cout << ".....Done generating....." << endl;
-        cout << "Total Bytes Generated: " << uint64_t(fullPacket.size()) << endl;
-        cout << "Total Bursts Generated: " << uint64_t(totalBursts) << endl;
-        cout << "Burst Size: " << uint64_t(burstSize) << endl;
-        cout << "Total Ethernet Frames: " << uint64_t(totalBursts*burstSize) << endl;
-        cout << "Ethernet Frame Size (Including IFGs): " << uint64_t(tempFrame.size()) << endl;
+    // Format `lines` groups of 4 bytes, each followed by a line break
+    static char *encodeLinesTable(const uint8_t *data, uint64_t lines, char *out)
+    {
+        const auto &pairs = digitPairs();
+        for (uint64_t i = 0; i < lines; i++, data += 4, out += 9)
+        {
+            memcpy(out + 0, &pairs[data[0]], 2);
+            memcpy(out + 2, &pairs[data[1]], 2);
+            memcpy(out + 4, &pairs[data[2]], 2);
+            memcpy(out + 6, &pairs[data[3]], 2);
+            out[8] = '\n';
+        }
+        return out;
+    }
+
+#ifdef HAVE_X86_INTRINSICS
+    // 16 bytes (4 lines) per iteration: split the nibbles, map them to digits with one shuffle each,
+    // interleave them and store the 8-character lines with their line breaks
+    __attribute__((target("ssse3"))) static char *encodeLinesSsse3(const uint8_t *data, uint64_t lines, char *out)
+    {
+        const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+        const __m128i lowNibble = _mm_set1_epi8(0x0F);
+
+        for (; lines >= 4; lines -= 4, data += 16, out += 36)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+            __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), lowNibble));
+            __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, lowNibble));
+            __m128i first = _mm_unpacklo_epi8(high, low);  // Characters of bytes 0-7
+            __m128i second = _mm_unpackhi_epi8(high, low); // Characters of bytes 8-15
+
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 0), first);
+            out[8] = '\n';
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 9), _mm_srli_si128(first, 8));
+            out[17] = '\n';
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 18), second);
+            out[26] = '\n';
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 27), _mm_srli_si128(second, 8));
+            out[35] = '\n';
+        }
+        return encodeLinesTable(data, lines, out);
+    }
+#endif
 
-        // Return the full packet stream
-        return fullPacket;
+    // Pick the line kernel supported by the running CPU
+    static char *(*kernel())(const uint8_t *, uint64_t, char *)
+    {
+        static char *(*const selected)(const uint8_t *, uint64_t, char *) = []
+        {
+#ifdef HAVE_X86_INTRINSICS
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("ssse3"))
+            {
+                return encodeLinesSsse3;
+            }
+#endif
+            return encodeLinesTable;
+        }();
+        return selected;
     }
 };
 
-void writePacketStreamToFile(const vector<uint8_t> &fullPacketStream, const string &fileName)
+// Write bytes as 2-digit hex values with a line break after every 4 bytes (the packets.txt layout).
+// `counter` holds the number of bytes already on the current line, so a stream can be written in pieces.
+// The text is formatted in large blocks and written with a few large write calls.
+void writeHexLines(ostream &file, const uint8_t *data, uint64_t length, uint8_t &counter)
 {
-    // Create and open a text file to store the generated packet stream
-    ofstream MyFile(fileName);
+    vector<char> text(hexEncoder::encodedSize(min<uint64_t>(length, HEX_EXPORT_BLOCK), 3));
+    while (length > 0)
+    {
+        uint64_t block = min<uint64_t>(length, HEX_EXPORT_BLOCK);
+        char *end = hexEncoder::encode(data, block, counter, text.data());
+        file.write(text.data(), end - text.data());
+        data += block;
+        length -= block;
+    }
+}
 
-    // Counter to insert a line break after every 4 bytes
-    uint8_t counter{0};
+#ifndef _WIN32
+// Write all `length` bytes at `offset` of the open file `fd`, retrying partial writes
+bool pwriteAll(int fd, const char *data, uint64_t length, uint64_t offset)
+{
+    while (length > 0)
+    {
+        ssize_t written = pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        offset += written;
+        length -= written;
+    }
+    return true;
+}
 
-    cout << ".....Start exporting stream to the text file....." << endl;
-    // Loop through the fullPacketStream and write each byte to the text file
-    for (auto byte : fullPacketStream)
+// Reserve the final size of an output file up front so that positional writes land in allocated blocks
+void preallocateFile(int fd, uint64_t size)
+{
+#ifdef __linux__
+    if (fallocate(fd, 0, 0, static_cast<off_t>(size)) == 0)
+    {
+        return;
+    }
+#endif
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        throw runtime_error("Failed to size the output file");
+    }
+}
+
+// Format the bytes found at `streamOffset` of the stream in the packets.txt layout and write them at their
+// place in the open file `fd`. Every 4 stream bytes become exactly 9 characters, so the file offset of any
+// byte is known in advance: the bytes are split into `threads` slices of whole lines, and each thread
+// formats its slice block by block and writes each block with pwrite at its final offset.
+void pwriteHexAt(int fd, const uint8_t *data, uint64_t length, uint64_t streamOffset, unsigned threads)
+{
+    uint64_t end = streamOffset + length;
+    uint64_t linesPerSlice = ((length + 3) / 4 + threads - 1) / threads;
+    atomic<bool> failed{false};
+
+    auto exportSlice = [&](uint64_t sliceBegin, uint64_t sliceEnd)
+    {
+        vector<char> text(hexEncoder::encodedSize(HEX_EXPORT_BLOCK, 3));
+        for (uint64_t block = sliceBegin; block < sliceEnd && !failed; block += HEX_EXPORT_BLOCK)
+        {
+            uint64_t blockLength = min<uint64_t>(HEX_EXPORT_BLOCK, sliceEnd - block);
+            uint8_t counter = block % 4; // Bytes already on the line this block starts in
+            char *stop = hexEncoder::encode(data + (block - streamOffset), blockLength, counter, text.data());
+            if (!pwriteAll(fd, text.data(), stop - text.data(), hexEncoder::encodedSize(block, 0)))
+            {
+                failed = true;
+            }
+        }
+    };
+
+    // Slices start on line boundaries of the stream, except the first one
+    vector<thread> workers;
+    uint64_t sliceBegin = streamOffset;
+    while (sliceBegin < end)
+    {
+        uint64_t sliceEnd = min(end, (sliceBegin / 4 + linesPerSlice) * 4);
+        workers.emplace_back(exportSlice, sliceBegin, sliceEnd);
+        sliceBegin = sliceEnd;
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    if (failed)
+    {
+        throw runtime_error("Failed to write the output file");
+    }
+}
+#endif
+
+// Splits a raw stream back into Ethernet frames. IFG bytes (0x07) between frames are skipped, the 8-byte
+// preamble and SFD are checked and dropped, and the frame length (MAC header, payload and FCS) is taken
+// from the length field of the MAC header. The stream may be fed in pieces of any size.
+class streamDeframer
+{
+public:
+    using frameHandler = function<void(const uint8_t *frame, uint64_t length, uint64_t streamOffset)>;
+
+private:
+    static constexpr uint64_t preambleSize = 8;
+    static constexpr uint64_t headerSize = 14;
+    static constexpr uint64_t fcsSize = 4;
+
+    frameHandler handler;
+    vector<uint8_t> frame;    // Bytes of the current frame, preamble excluded
+    uint64_t position{0};     // Stream offset of the next byte fed in
+    uint64_t frameStart{0};   // Stream offset of the preamble of the current frame
+    uint64_t preambleLeft{0}; // Preamble bytes of the current frame still to skip
+    uint64_t frameLength{0};  // Size of the current frame once its header is complete (0 = not known yet)
+    bool inFrame{false};
+
+public:
+    streamDeframer(frameHandler Handler) : handler(move(Handler))
+    {
+    }
+
+    void feed(const uint8_t *data, uint64_t length)
     {
-        // Write each byte as a 2-digit hex value, ensuring leading zeros
-        MyFile << hex << setw(2) << setfill('0') << static_cast<uint64_t>(byte);
+        const uint8_t *end = data + length;
+        while (data < end)
+        {
+            if (!inFrame)
+            {
+                // Skip the IFGs up to the next preamble
+                const uint8_t *start = data;
+                while (data < end && *data == 0x07)
+                {
+                    data++;
+                }
+                position += data - start;
+                if (data == end)
+                {
+                    break;
+                }
+                inFrame = true;
+                frameStart = position;
+                preambleLeft = preambleSize;
+                frameLength = 0;
+                frame.clear();
+            }
 
-        // Insert a newline after every 4 bytes written to the file
-        if (counter == 3)
+            if (preambleLeft > 0)
+            {
+                uint64_t take = min<uint64_t>(preambleLeft, end - data);
+                preambleLeft -= take;
+                data += take;
+                position += take;
+                if (preambleLeft == 0 && data[-1] != 0xd5)
+                {
+                    throw runtime_error("Malformed stream: missing start frame delimiter at byte " + to_string(position - 1));
+                }
+                continue;
+            }
+
+            uint64_t wanted = frameLength ? frameLength : headerSize;
+            uint64_t take = min<uint64_t>(wanted - frame.size(), end - data);
+            frame.insert(frame.end(), data, data + take);
+            data += take;
+            position += take;
+            if (frame.size() < wanted)
+            {
+                continue;
+            }
+
+            if (frameLength == 0)
+            {
+                // The header is complete: the length field gives the payload size
+                frameLength = headerSize + ((uint64_t(frame[12]) << 8) | frame[13]) + fcsSize;
+                continue;
+            }
+
+            handler(frame.data(), frame.size(), frameStart);
+            inFrame = false;
+        }
+    }
+
+    // True when the stream ended between frames
+    bool idle() const { return !inFrame; }
+};
+
+// Writes Ethernet frames to a pcapng capture (one section, one Ethernet interface with nanosecond
+// timestamps). Frames keep their FCS, which the interface advertises through if_fcslen. Blocks are
+// collected in a buffer and written PCAPNG_WRITE_BLOCK bytes at a time.
+class pcapngWriter
+{
+private:
+    ofstream file;
+    vector<uint8_t> buffer;
+    uint64_t frames{0};
+
+    void put32(uint32_t value)
+    {
+        uint8_t bytes[4];
+        memcpy(bytes, &value, 4); // pcapng is written in host byte order, the byte-order magic tells readers which
+        buffer.insert(buffer.end(), bytes, bytes + 4);
+    }
+
+    void put16(uint16_t value)
+    {
+        uint8_t bytes[2];
+        memcpy(bytes, &value, 2);
+        buffer.insert(buffer.end(), bytes, bytes + 2);
+    }
+
+    void flush()
+    {
+        file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<streamsize>(buffer.size()));
+        buffer.clear();
+    }
+
+public:
+    pcapngWriter(const string &fileName) : file(fileName, ios::out | ios::binary)
+    {
+        if (!file)
         {
-            MyFile << endl;
-            counter = 0; // Reset the counter
+            throw runtime_error("Failed to open output file " + fileName);
+        }
+        buffer.reserve(PCAPNG_WRITE_BLOCK + 65536);
+
+        // Section Header Block: byte-order magic, version 1.0, unknown section length
+        put32(0x0A0D0D0A);
+        put32(28);
+        put32(0x1A2B3C4D);
+        put16(1);
+        put16(0);
+        put32(0xFFFFFFFF);
+        put32(0xFFFFFFFF);
+        put32(28);
+
+        // Interface Description Block: Ethernet, no snap length, if_tsresol = 9 (ns), if_fcslen = 4
+        put32(0x00000001);
+        put32(40);
+        put16(1);
+        put16(0);
+        put32(0);
+        put16(9);
+        put16(1);
+        put32(9);
+        put16(13);
+        put16(1);
+        put32(4);
+        put32(0);
+        put32(40);
+    }
+
+    ~pcapngWriter()
+    {
+        close();
+    }
+
+    // Append one frame (MAC header through FCS) captured at `timestampNs`
+    void writeFrame(const uint8_t *frame, uint64_t length, uint64_t timestampNs)
+    {
+        uint32_t padded = static_cast<uint32_t>((length + 3) & ~uint64_t(3));
+        uint32_t blockLength = 32 + padded;
+
+        // Enhanced Packet Block on interface 0
+        put32(0x00000006);
+        put32(blockLength);
+        put32(0);
+        put32(static_cast<uint32_t>(timestampNs >> 32));
+        put32(static_cast<uint32_t>(timestampNs));
+        put32(static_cast<uint32_t>(length));
+        put32(static_cast<uint32_t>(length));
+        buffer.insert(buffer.end(), frame, frame + length);
+        buffer.insert(buffer.end(), padded - length, 0);
+        put32(blockLength);
+        frames++;
+
+        if (buffer.size() >= PCAPNG_WRITE_BLOCK)
+        {
+            flush();
+        }
+    }
+
+    void close()
+    {
+        if (file.is_open())
+        {
+            flush();
+            file.close();
+        }
+    }
+
+    uint64_t getFrames() const { return frames; }
+};
+
+// Function to export the generated packet stream to a pcapng capture. Preamble and IFGs are stripped and
+// every frame is stamped with its byte offset in the stream at the line rate (in Gbps, i.e. bits per ns).
+void writePacketStreamToPcapng(const streamDescriptor &stream, const string &fileName, uint64_t lineRate)
+{
+    if (lineRate == 0)
+    {
+        throw runtime_error("Eth.LineRate must be positive to timestamp a capture");
+    }
+
+    cout << ".....Start exporting stream to the pcapng file....." << endl;
+    pcapngWriter capture(fileName);
+    streamDeframer deframer([&](const uint8_t *frame, uint64_t length, uint64_t streamOffset)
+                            { capture.writeFrame(frame, length, streamOffset * 8 / lineRate); });
+    stream.forEachChunk([&](const uint8_t *data, uint64_t length, uint64_t)
+                        { deframer.feed(data, length); });
+    if (!deframer.idle())
+    {
+        throw runtime_error("Malformed stream: the last frame is truncated");
+    }
+    capture.close();
+    cout << "Captured Frames: " << capture.getFrames() << endl;
+    cout << ".....Done exporting....." << endl;
+}
+
+// Compact container of a stream: frames are stored verbatim and IFG runs by their length only. A 24-byte
+// header (magic "ORANRLE1", then the stream size in bytes and the line rate in Gbps, little-endian) is
+// followed by records, each starting with the LEB128 varint (length << 1 | idle). An idle record stands for
+// `length` IFG bytes (0x07); any other record is followed by its `length` bytes. IFG runs shorter than
+// RLE_MIN_IDLE_RUN bytes stay in the literal bytes, where they cost less than a record.
+class rleEncoder
+{
+public:
+    static constexpr char magic[8] = {'O', 'R', 'A', 'N', 'R', 'L', 'E', '1'};
+    static constexpr uint64_t headerSize = 24;
+
+private:
+    ofstream file;
+    vector<uint8_t> buffer;  // Records waiting to be written
+    vector<uint8_t> literal; // Bytes of the literal record in progress
+    uint64_t idleRun{0};     // IFG bytes of the run in progress
+    uint64_t encodedBytes{headerSize};
+
+    void put64(uint64_t value)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void putVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            buffer.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    void flushLiteral()
+    {
+        if (!literal.empty())
+        {
+            putVarint(literal.size() << 1);
+            buffer.insert(buffer.end(), literal.begin(), literal.end());
+            literal.clear();
+        }
+    }
+
+    void endIdleRun()
+    {
+        if (idleRun >= RLE_MIN_IDLE_RUN)
+        {
+            flushLiteral();
+            putVarint(idleRun << 1 | 1);
         }
         else
         {
-            counter++;
+            literal.insert(literal.end(), idleRun, 0x07);
+        }
+        idleRun = 0;
+    }
+
+    void flush()
+    {
+        file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<streamsize>(buffer.size()));
+        encodedBytes += buffer.size();
+        buffer.clear();
+    }
+
+public:
+    rleEncoder(const string &fileName, uint64_t streamBytes, uint64_t lineRate) : file(fileName, ios::out | ios::binary)
+    {
+        if (!file)
+        {
+            throw runtime_error("Failed to open output file " + fileName);
         }
+        buffer.reserve(RLE_WRITE_BLOCK + 16);
+        file.write(magic, sizeof(magic));
+        put64(streamBytes);
+        put64(lineRate);
+        file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<streamsize>(buffer.size()));
+        buffer.clear();
     }
+
+    ~rleEncoder()
+    {
+        close();
+    }
+
+    // Encode the next `length` bytes of the stream; runs and records may span calls
+    void feed(const uint8_t *data, uint64_t length)
+    {
+        const uint8_t *end = data + length;
+        while (data < end)
+        {
+            if (*data == 0x07)
+            {
+                // Long idle runs are skipped eight bytes at a time
+                const uint8_t *start = data;
+                uint64_t word;
+                while (end - data >= 8 && (memcpy(&word, data, 8), word == 0x0707070707070707ULL))
+                {
+                    data += 8;
+                }
+                while (data < end && *data == 0x07)
+                {
+                    data++;
+                }
+                idleRun += data - start;
+                continue;
+            }
+            if (idleRun > 0)
+            {
+                endIdleRun();
+            }
+            const uint8_t *next = static_cast<const uint8_t *>(memchr(data, 0x07, end - data));
+            next = next ? next : end;
+            literal.insert(literal.end(), data, next);
+            data = next;
+            if (literal.size() >= RLE_WRITE_BLOCK)
+            {
+                flushLiteral();
+            }
+            if (buffer.size() >= RLE_WRITE_BLOCK)
+            {
+                flush();
+            }
+        }
+    }
+
+    void close()
+    {
+        if (file.is_open())
+        {
+            if (idleRun > 0)
+            {
+                endIdleRun();
+            }
+            flushLiteral();
+            flush();
+            file.close();
+        }
+    }
+
+    // Size of the container so far, header included
+    uint64_t getEncodedBytes() const { return encodedBytes + buffer.size(); }
+};
+
+// Function to export the generated packet stream to an RLE container, which the second milestone's
+// "--expand" turns back into packets.txt, raw bytes or a pcapng capture
+void writePacketStreamToRle(const streamDescriptor &stream, const string &fileName, uint64_t lineRate)
+{
+    cout << ".....Start exporting stream to the RLE container....." << endl;
+    rleEncoder container(fileName, stream.size(), lineRate);
+    stream.forEachChunk([&](const uint8_t *data, uint64_t length, uint64_t)
+                        { container.feed(data, length); });
+    container.close();
+    cout << "Encoded Bytes: " << container.getEncodedBytes() << endl;
+    cout << ".....Done exporting....." << endl;
+}
+
+void writePacketStreamToFile(const streamDescriptor &stream, const string &fileName, unsigned threads = 1)
+{
+    cout << ".....Start exporting stream to the text file....." << endl;
+
+#ifndef _WIN32
+    if (threads > 1)
+    {
+        // Preallocate the text file and let every thread write its slice at its final offset
+        int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            throw runtime_error("Failed to open output file " + fileName);
+        }
+        preallocateFile(fd, hexEncoder::encodedSize(stream.size(), 0));
+        stream.forEachChunk([&](const uint8_t *data, uint64_t length, uint64_t streamOffset)
+                            { pwriteHexAt(fd, data, length, streamOffset, threads); });
+        close(fd);
+        cout << ".....Done exporting....." << endl;
+        return;
+    }
+#else
+    (void)threads; // Positional writes are POSIX only, main rejects --export-threads elsewhere
+#endif
+
+    // Create and open a text file to store the generated packet stream
+    ofstream MyFile(fileName);
+
+    // Counter to insert a line break after every 4 bytes
+    uint8_t counter{0};
+
+    // Write each byte of the stream as a 2-digit hex value, 4 bytes per line, one chunk at a time
+    stream.forEachChunk([&](const uint8_t *data, uint64_t length, uint64_t)
+                        { writeHexLines(MyFile, data, length, counter); });
     cout << ".....Done exporting....." << endl;
     // Close the file after writing is done
     MyFile.close();
 }
 
+// Checks crc32Engine against the bitwise CRC-32 loop of the original EthFrame::crc32, run with --self-test:
+// lengths 0..4096 at 17 start alignments, and updates split at every point of a few lengths.
+// Returns false on any mismatch.
+bool crcSelfTest()
+{
+    auto bitwiseCrc = [](uint32_t crc, const uint8_t *data, uint64_t length)
+    {
+        while (length--)
+        {
+            crc ^= *data++;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+            }
+        }
+        return crc;
+    };
+
+    const uint64_t maxLength = 4096;
+    const uint64_t alignments = 17;
+    vector<uint8_t> buffer(maxLength + alignments);
+    uint32_t seed = 1;
+    for (uint8_t &byte : buffer)
+    {
+        seed = seed * 1664525 + 1013904223;
+        byte = static_cast<uint8_t>(seed >> 24);
+    }
+
+    uint64_t cases = 0, mismatches = 0;
+    for (uint64_t alignment = 0; alignment < alignments; alignment++)
+    {
+        const uint8_t *data = buffer.data() + alignment;
+        uint32_t reference = 0xFFFFFFFF; // Grows one byte per length
+        for (uint64_t length = 0; length <= maxLength; length++)
+        {
+            mismatches += crc32Engine::updateTable(0xFFFFFFFF, data, length) != reference;
+            mismatches += crc32Engine::compute(data, length) != (reference ^ 0xFFFFFFFF);
+            cases += 2;
+            reference = bitwiseCrc(reference, data + length, 1);
+        }
+    }
+    for (uint64_t length : {0, 1, 15, 16, 63, 64, 65, 127, 300, 1500, 4096})
+    {
+        const uint8_t *data = buffer.data() + length % alignments;
+        uint32_t reference = bitwiseCrc(0xFFFFFFFF, data, length);
+        for (uint64_t split = 0; split <= length; split++)
+        {
+            mismatches += crc32Engine::update(crc32Engine::update(0xFFFFFFFF, data, split), data + split, length - split) != reference;
+            cases++;
+        }
+    }
+
+    cout << "crc32 self test: " << cases << " cases, " << mismatches << " mismatches  " << (mismatches ? "FAILED" : "passed") << endl;
+    return mismatches == 0;
+}
+
 //==================================================================================//
-int main()
+int main(int argc, char *argv[])
 {
+    // Optional "--export-threads N" formats and writes packets.txt on N threads (0 = one per hardware thread),
+    // "--format pcapng" writes a pcapng capture (packets.pcapng unless "--output" names another file),
+    // "--format rle" an RLE container with the IFG runs stored by length (packets.rle),
+    // "--self-test" checks the CRC-32 engine against the bitwise loop and exits
+    unsigned exportThreads{1};
+    string format{"hex"};
+    string outputFile;
+    for (int i = 1; i < argc; ++i)
+    {
+        string option = argv[i];
+        if (option == "--export-threads" && i + 1 < argc)
+        {
+#ifdef _WIN32
+            cerr << "--export-threads is only available on POSIX systems" << endl;
+            return 1;
+#endif
+            exportThreads = static_cast<unsigned>(stoul(argv[++i]));
+            if (exportThreads == 0)
+            {
+                exportThreads = max(1u, thread::hardware_concurrency());
+            }
+        }
+        else if (option == "--format" && i + 1 < argc &&
+                 (string(argv[i + 1]) == "hex" || string(argv[i + 1]) == "pcapng" || string(argv[i + 1]) == "rle"))
+        {
+            format = argv[++i];
+        }
+        else if (option == "--output" && i + 1 < argc)
+        {
+            outputFile = argv[++i];
+        }
+        else if (option == "--self-test")
+        {
+            return crcSelfTest() ? 0 : 1;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--export-threads N] [--format hex|pcapng|rle] [--output FILE] [--self-test]" << endl;
+            return 1;
+        }
+    }
+    if (outputFile.empty())
+    {
+        outputFile = format == "pcapng" ? "packets.pcapng" : format == "rle" ? "packets.rle" : "packets.txt";
+    }
+
     // Initialize a vector of payload data (currently with a single byte of 0x00)
     vector<uint8_t> data = {0x00};
 
-    // Vector to store the full packet stream generated later
-    vector<uint8_t> fullPacketStream;
-
     // Parse configuration file "first_milestone.txt" to extract Ethernet settings
     parseConfigurations configuration("first_milestone.txt");
 
     // Create packetStreaming object using configuration data and payload
     packetStreaming fullStream{configuration, data};
 
-    // Construct the full packet stream with bursts and IFGs
-    fullPacketStream = fullStream.constructStream();
+    // Describe the full packet stream with bursts and IFGs
+    streamDescriptor fullPacketStream = fullStream.describeStream();
 
-    // Call the new function to write the full packet stream to "packets.txt"
-    writePacketStreamToFile(fullPacketStream, "packets.txt");
+    // Write the full packet stream to "packets.txt", or to a pcapng capture or an RLE container. Each
+    // exporter materializes the stream chunk by chunk, so the memory use does not grow with the capture.
+    if (format == "pcapng")
+    {
+        writePacketStreamToPcapng(fullPacketStream, outputFile, configuration.LineRate);
+    }
+    else if (format == "rle")
+    {
+        writePacketStreamToRle(fullPacketStream, outputFile, configuration.LineRate);
+    }
+    else
+    {
+        writePacketStreamToFile(fullPacketStream, outputFile, exportThreads);
+    }
 
     return 0;
 }
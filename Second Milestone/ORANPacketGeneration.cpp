@@ -15,9 +15,44 @@
 #include <array>
 #include <vector>
 #include <cstdint>
+#include <cstring>
 #include <map>
+#include <unordered_map>
 #include <cmath>
 #include <random>
+#include <numeric>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <charconv>
+#include <filesystem>
+#include <system_error>
+#include <chrono>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_INTRINSICS 1
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__)
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#define CRC32_HAVE_ARMV8 1
+#endif
 
 #define ETH_HEADER_SIZE 26
 #define FRAME_PERIOD_MS 10
@@ -25,19 +60,30 @@
 #define SUBFRAME_PER_FRAME 10
 #define SYMBOL_PER_SLOT 14
 #define RE_PER_RB 12
+#define ECPRI_IQ_DATA 0    // eCPRI message type of U-plane (IQ data) messages
+#define ECPRI_RT_CONTROL 2 // eCPRI message type of C-plane (real-time control data) messages
+#define STREAM_CHUNK_SIZE (4ULL << 20)                // Bytes handed to a stream sink at a time
+#define HEX_EXPORT_BLOCK (1ULL << 20)                 // Bytes formatted per write call by the hex exporter
+#define FRAME_TEMPLATE_CACHE_MAX_BYTES (256ULL << 20) // Memory budget for pre-built fixed-payload frame bodies
+#define PCAPNG_WRITE_BLOCK (1ULL << 20)               // Bytes of pcapng blocks buffered per write call
+#define SHM_RING_DESCRIPTORS (1ULL << 16)             // Frame descriptors of the shared-memory ring (a power of two)
+#define SHM_RING_DATA_BYTES (64ULL << 20)             // Frame bytes the shared-memory ring can hold
+#define SHM_PEER_TIMEOUT 10                           // Seconds either side of the shm ring waits for a silent peer (--shm-timeout)
+#define SEGMENT_WRITER_BUFFERS 4                      // Chunks queued between the generator and the segment writer
+#define RLE_MIN_IDLE_RUN 8                            // Shortest IFG run stored as an idle record of an RLE container
+#define RLE_WRITE_BLOCK (1ULL << 20)                  // Bytes of RLE records buffered per write call
 
 using namespace std;
 
-// Function to convert a given number into an array of bytes, with the least significant byte at the lowest index.
+// Function to convert a given number into an array of its low `my_size` bytes, most significant byte first
+// (network order, as MAC addresses are written).
 template <typename intType, uint8_t my_size>
-array<uint8_t, my_size> intToArray(intType number)
+constexpr array<uint8_t, my_size> intToArray(intType number)
 {
-    array<uint8_t, my_size> result;
-    uint8_t *byte = reinterpret_cast<uint8_t *>(&number);
-
-    for (char i = my_size - 1; i >= 0; --i)
+    array<uint8_t, my_size> result{};
+    for (uint8_t i = 0; i < my_size; i++)
     {
-        result[i] = *byte++;
+        result[i] = static_cast<uint8_t>(static_cast<uint64_t>(number) >> (8 * (my_size - 1 - i)));
     }
     return result;
 }
@@ -55,311 +101,4036 @@ uint64_t convertIntoInteger(string str)
     }
 }
 
-class parseConfigurations
+// Redirects the progress reports of the calling thread (see console()) to another stream for its lifetime
+class scopedConsole
 {
-public:
-    // Ethernet Configuration parameters parsed from the file
-    uint8_t LineRate;              // Ethernet line rate (in Gbps)
-    uint8_t CaptureSizeMs;         // Capture duration in milliseconds
-    uint8_t MinNumOfIFGsPerPacket; // Minimum number of inter-frame gaps (IFGs) per packet
-    uint64_t DestAddress;          // Destination MAC address
-    uint64_t SourceAddress;        // Source MAC address
-    uint16_t MaxPacketSize;        // Maximum packet size (in bytes)
+private:
+    ostream *previous;
 
-    // ORAN Configuration parameters parsed from the file
-    uint8_t SCS;           // Subcarrier spacing
-    uint16_t MaxNrb;       // Maximum number of resource blocks
-    uint16_t NrbPerPacket; // Number of resource blocks per packet
-    string PayloadType;    // Type of payload: "fixed" or "random"
+public:
+    // The stream the calling thread reports on, cout unless redirected
+    static ostream *&target()
+    {
+        thread_local ostream *stream = &cout;
+        return stream;
+    }
 
-    vector<int8_t> iqSamples; // IQ Samples extracted from the provided file
+    scopedConsole(ostream &stream) : previous(target())
+    {
+        target() = &stream;
+    }
 
-    // Constructor that reads the configuration values from a file
-    parseConfigurations(string fileName)
+    ~scopedConsole()
     {
-        cout << "========= Start Parsing =========" << endl;
+        target() = previous;
+    }
 
-        // Open the configuration file for reading
-        ifstream MyReadFile(fileName);
+    scopedConsole(const scopedConsole &) = delete;
+    scopedConsole &operator=(const scopedConsole &) = delete;
+};
 
-        // Check if the file opened successfully
-        if (!MyReadFile)
+// Stream the configuration parser, the generator and the sinks report on. Sweep runs each report on a
+// stream of their own, so concurrent runs never write to cout or change its formatting.
+ostream &console()
+{
+    return *scopedConsole::target();
+}
+
+// Quote a string for a JSON file, escaping backslashes, quotes and control characters
+string jsonString(const string &text)
+{
+    ostringstream quoted;
+    quoted << '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
         {
-            throw runtime_error("Failed to open configuration file!");
+            quoted << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            quoted << "\\u" << hex << setw(4) << setfill('0') << int(c) << dec;
         }
+        else
+        {
+            quoted << c;
+        }
+    }
+    quoted << '"';
+    return quoted.str();
+}
 
-        // String to hold each line from the configuration file
-        string line;
+// Stages timed by the optional instrumentation (--stats). Times are inclusive: iqLoad runs inside
+// configParse, and payloadFetch, headerPacking and crc run inside frameAssembly.
+enum class stage : uint8_t
+{
+    configParse,
+    iqLoad,
+    payloadFetch,
+    headerPacking,
+    crc,
+    frameAssembly,
+    streamAppend,
+    exportStream,
+    count
+};
 
-        // Create a map to store key-value pairs from the file
-        map<string, string> config;
+// Low-overhead per-stage counters. When disabled a scoped timer costs one relaxed load. When enabled it
+// reads the time stamp counter on entry and exit and adds the difference to counters of the calling
+// thread, which are merged into the totals when the thread exits, so worker threads never share a line.
+class stageStats
+{
+private:
+    static constexpr size_t stages = static_cast<size_t>(stage::count);
 
-        // Read the file line by line
-        while (getline(MyReadFile, line))
+    struct counters
+    {
+        array<uint64_t, stages> ticks{};
+        array<uint64_t, stages> calls{};
+        array<uint64_t, stages> bytes{};
+
+        void mergeInto(counters &other) const
         {
-            // Skip empty lines
-            if (line.empty())
+            for (size_t i = 0; i < stages; i++)
             {
-                continue;
+                other.ticks[i] += ticks[i];
+                other.calls[i] += calls[i];
+                other.bytes[i] += bytes[i];
             }
+        }
+    };
 
-            // Remove all whitespace characters from the line
-            line.erase(remove_if(line.begin(), line.end(), [](unsigned char x)
-                                 { return isspace(x); }),
-                       line.end());
-
-            // Remove comments (anything after "//")
-            auto comment_pos = line.find("//");
-            if (comment_pos != string::npos)
-            {
-                line.erase(line.begin() + line.find("//"), line.end());
-            }
+    // Counters of one thread, added to the totals when the thread ends
+    struct threadCounters : counters
+    {
+        ~threadCounters()
+        {
+            lock_guard<mutex> lock(totalsMutex());
+            mergeInto(totals());
+        }
+    };
 
-            // Split the line at the '=' sign
-            auto key = line.substr(0, line.find('='));
-            auto valueStr = line.substr(line.find('=') + 1);
+    static atomic<bool> &enabledFlag()
+    {
+        static atomic<bool> flag{false};
+        return flag;
+    }
+    static counters &totals()
+    {
+        static counters all;
+        return all;
+    }
+    static mutex &totalsMutex()
+    {
+        static mutex guard;
+        return guard;
+    }
+    static counters &local()
+    {
+        thread_local threadCounters mine;
+        return mine;
+    }
 
-            // Store the key-value pair in the map
-            config[key] = valueStr;
+    // Tick source and its calibration against steady_clock, taken between enable() and writeJson()
+    struct calibration
+    {
+        uint64_t ticks;
+        chrono::steady_clock::time_point time;
+    };
+    static calibration &started()
+    {
+        static calibration start{};
+        return start;
+    }
 
-            cout << key << ": " << valueStr << endl;
-        }
+public:
+    static atomic<uint64_t> allocations;
+    static atomic<uint64_t> allocatedBytes;
 
-        cout << "========= Done Parsing =========" << endl;
+    static bool enabled()
+    {
+        return enabledFlag().load(memory_order_relaxed);
+    }
 
-        // Close the file
-        MyReadFile.close();
+    static void enable()
+    {
+        started() = calibration{ticks(), chrono::steady_clock::now()};
+        enabledFlag().store(true, memory_order_relaxed);
+    }
 
-        // Set the configuration fields from the map values
-        LineRate = static_cast<uint8_t>(convertIntoInteger(config["Eth.LineRate"]));
-        CaptureSizeMs = static_cast<uint8_t>(convertIntoInteger(config["Eth.CaptureSizeMs"]));
-        MinNumOfIFGsPerPacket = static_cast<uint8_t>(convertIntoInteger(config["Eth.MinNumOfIFGsPerPacket"]));
-        DestAddress = convertIntoInteger(config["Eth.DestAddress"]);
-        SourceAddress = convertIntoInteger(config["Eth.SourceAddress"]);
-        MaxPacketSize = static_cast<uint16_t>(convertIntoInteger(config["Eth.MaxPacketSize"]));
+    static uint64_t ticks()
+    {
+#ifdef HAVE_X86_INTRINSICS
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
 
-        SCS = static_cast<uint8_t>(convertIntoInteger(config["Oran.SCS"]));
-        MaxNrb = static_cast<uint16_t>(convertIntoInteger(config["Oran.MaxNrb"]));
-        NrbPerPacket = static_cast<uint16_t>(convertIntoInteger(config["Oran.NrbPerPacket"]));
-        PayloadType = config["Oran.PayloadType"];
+    static void record(stage id, uint64_t elapsed, uint64_t bytes)
+    {
+        counters &mine = local();
+        size_t i = static_cast<size_t>(id);
+        mine.ticks[i] += elapsed;
+        mine.calls[i]++;
+        mine.bytes[i] += bytes;
+    }
 
-        iqSamples = parseIQSamples(config["Oran.Payload"]);
+    static const char *name(stage id)
+    {
+        static const char *names[stages] = {"config_parse", "iq_load", "payload_fetch", "header_packing",
+                                            "crc", "frame_assembly", "stream_append", "export"};
+        return names[static_cast<size_t>(id)];
     }
 
-    // Function to parse IQ Samples from a file
-    vector<int8_t> parseIQSamples(string fileName)
+    // Write the stage times together with the generation totals. `generationSeconds` is the wall time of
+    // generateStream and `lineRate` is Eth.LineRate in Gbps.
+    static void writeJson(const string &fileName, const string &configFile, uint64_t lineRate, uint64_t frames,
+                          uint64_t bytes, double generationSeconds)
     {
-        // Open the file for reading
-        ifstream file(fileName);
+        calibration now{ticks(), chrono::steady_clock::now()};
+        double seconds = chrono::duration<double>(now.time - started().time).count();
+        double ticksPerSecond = seconds > 0 ? (now.ticks - started().ticks) / seconds : 1e9;
 
-        // Check if the file opened successfully
+        counters all;
+        {
+            lock_guard<mutex> lock(totalsMutex());
+            all = totals();
+        }
+        local().mergeInto(all);
+
+        ofstream file(fileName);
         if (!file)
         {
-            throw runtime_error("Failed to open IQ sample file!");
+            throw runtime_error("Failed to open stats file " + fileName);
+        }
+        double gbps = generationSeconds > 0 ? 8.0 * bytes / generationSeconds / 1e9 : 0.0;
+        file << setprecision(10) << "{\n  \"config\": " << jsonString(configFile) << ",\n  \"line_rate_gbps\": " << lineRate
+             << ",\n  \"frames\": " << frames << ",\n  \"bytes\": " << bytes
+             << ",\n  \"generation_seconds\": " << generationSeconds << ",\n  \"generation_gbps\": " << gbps
+             << ",\n  \"line_rate_ratio\": " << (lineRate ? gbps / lineRate : 0.0)
+             << ",\n  \"allocations\": " << allocations.load() << ",\n  \"allocated_bytes\": " << allocatedBytes.load()
+             << ",\n  \"ticks_per_second\": " << ticksPerSecond << ",\n  \"stages\": [\n";
+        for (size_t i = 0; i < stages; i++)
+        {
+            file << "    {\"stage\": " << jsonString(name(static_cast<stage>(i))) << ", \"calls\": " << all.calls[i]
+                 << ", \"seconds\": " << all.ticks[i] / ticksPerSecond << ", \"bytes\": " << all.bytes[i] << "}"
+                 << (i + 1 < stages ? ",\n" : "\n");
         }
+        file << "  ]\n}\n";
+        cout << "Stage statistics written to .\\" << fileName << endl;
+    }
+};
 
-        vector<int8_t> samples; // Vector to store the IQ samples
+atomic<uint64_t> stageStats::allocations{0};
+atomic<uint64_t> stageStats::allocatedBytes{0};
 
-        string line; // String to hold each line from the file
+// Adds the time spent in its scope (and optionally the bytes it handled) to a stage
+class scopedStage
+{
+private:
+    stage id;
+    uint64_t bytes;
+    uint64_t start{0};
+    bool active;
 
-        // Read the file line by line
-        while (getline(file, line))
+public:
+    scopedStage(stage Id, uint64_t Bytes = 0) : id(Id), bytes(Bytes), active(stageStats::enabled())
+    {
+        if (active)
         {
-            // Use a stringstream to extract the two numbers from each line
-            stringstream ss(line);
-            int num1, num2;
+            start = stageStats::ticks();
+        }
+    }
 
-            // Extract the two integers
-            if (ss >> num1 >> num2)
-            {
-                samples.push_back(num1);
-                samples.push_back(num2);
-            }
+    ~scopedStage()
+    {
+        if (active)
+        {
+            stageStats::record(id, stageStats::ticks() - start, bytes);
         }
+    }
 
-        // Close the file after reading
-        file.close();
+    scopedStage(const scopedStage &) = delete;
+    scopedStage &operator=(const scopedStage &) = delete;
+};
 
-        // Return the parsed IQ samples
-        return samples;
+// Count heap allocations while the instrumentation is enabled
+void *operator new(size_t size)
+{
+    if (stageStats::enabled())
+    {
+        stageStats::allocations.fetch_add(1, memory_order_relaxed);
+        stageStats::allocatedBytes.fetch_add(size, memory_order_relaxed);
     }
-};
+    if (void *block = malloc(size ? size : 1))
+    {
+        return block;
+    }
+    throw bad_alloc();
+}
 
-// Class representing an ORAN packet
-class OranPacket
+void *operator new[](size_t size)
 {
-private:
-    array<uint8_t, 8> header;   // 8 bytes for the combined ORAN packet header
-    vector<int8_t> iqSamples;   // IQ samples associated with the packet
-    vector<uint8_t> oranPacket; // Complete ORAN packet
+    return operator new(size);
+}
 
-public:
-    // Constructor for the ORAN packet to initialize the headers
-    OranPacket(uint8_t frameId, uint8_t subframeId, uint8_t slotId, uint8_t symbolId,
-               uint16_t startPrbu, uint16_t numPrbu, vector<int8_t> data)
-    {
-        // Packing the first 4 bytes (Common Header)
-        header[0] = 0x00;                                       // dataDirection (1 bit), payloadVersion (3 bits), filterIndex (4 bits), all set to 0
-        header[1] = frameId;                                    // frameId (8 bits)
-        header[2] = (subframeId << 4) | ((slotId >> 2) & 0x0F); // Top 4 bits of subframeId, top 6 bits of slotId
-        header[3] = ((slotId & 0x03) << 6) | (symbolId & 0x3F); // Lower 6 bits of slotId, symbolId (6 bits)
+// Kept out of line, otherwise GCC sees free() inlined on memory from operator new and warns about a mismatch
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void *block) noexcept
+{
+    free(block);
+}
 
-        // Packing the next 4 bytes (Section Header)
-        header[4] = 0xFF;                             // sectionId (12 bits) fixed to 4095 (0xFFF)
-        header[5] = 0xF0 | ((startPrbu >> 8) & 0x03); // Lower 4 bits of sectionId, top 2 bits of startPrbu
-        header[6] = startPrbu & 0xFF;                 // Lower 8 bits of startPrbu
+void operator delete[](void *block) noexcept
+{
+    operator delete(block);
+}
 
-        header[7] = numPrbu == 273 ? 0 : numPrbu & 0xFF; // Handle maximum value for numPrbu
+void operator delete(void *block, size_t) noexcept
+{
+    operator delete(block);
+}
 
-        // Store the IQ samples
-        iqSamples = data;
-    }
+void operator delete[](void *block, size_t) noexcept
+{
+    operator delete(block);
+}
 
-    // Function to retrieve the complete ORAN packet (header + IQ samples)
-    vector<uint8_t> getPacket()
+// Function to split a comma-separated configuration value ("a,b,c") into its items
+vector<string> splitList(const string &str)
+{
+    vector<string> items;
+    size_t start = 0;
+    while (true)
     {
-        oranPacket.insert(oranPacket.end(), header.begin(), header.end());       // Insert header
-        oranPacket.insert(oranPacket.end(), iqSamples.begin(), iqSamples.end()); // Insert IQ samples
-
-        return oranPacket; // Return the complete ORAN packet
+        size_t comma = str.find(',', start);
+        items.push_back(str.substr(start, comma - start));
+        if (comma == string::npos)
+        {
+            return items;
+        }
+        start = comma + 1;
     }
-};
+}
 
-// Class representing an eCPRI packet
-class EcpriPacket
+// CRC-32 engine used for the Ethernet Frame Check Sequence (reflected polynomial 0xEDB88320).
+// The implementation is picked once at startup: carry-less multiplication folding (PCLMULQDQ) on x86,
+// the CRC32 instructions on ARMv8, and slicing-by-16 tables everywhere else or for short tails.
+class crc32Engine
 {
-private:
-    array<uint8_t, 8> header;    // 8 bytes for the eCPRI header
-    vector<uint8_t> payload;     // eCPRI payload (ORAN packet)
-    vector<uint8_t> ecpriPacket; // Complete eCPRI packet
-
 public:
-    // Constructor to initialize the eCPRI packet header
-    EcpriPacket(uint16_t ecpriSeqid, vector<uint8_t> ecpriPayload)
+    struct implementationEntry
     {
-        uint16_t ecpriPayloadSize{static_cast<uint16_t>(size(ecpriPayload))};
+        const char *name;
+        uint32_t (*update)(uint32_t, const uint8_t *, uint64_t);
+    };
 
-        header[0] = 0x00;                           // ecpriVersion (4 bits) + ecpriReserved (3 bits) + ecpriConcatenation (1 bit)
-        header[1] = 0x00;                           // ecpriMessage
-        header[2] = (ecpriPayloadSize >> 8) & 0xFF; // Upper 8 bits of ecpriPayloadSize
-        header[3] = ecpriPayloadSize & 0xFF;        // Lower 8 bits of ecpriPayloadSize
-        header[4] = 0x00;                           // Upper 8 bits of ecpriRTCid/ecpriPcid
-        header[5] = 0x00;                           // Lower 8 bits of ecpriRTCid/ecpriPcid
-        header[6] = (ecpriSeqid >> 8) & 0xFF;       // Upper 8 bits of ecpriSeqid
-        header[7] = ecpriSeqid & 0xFF;              // Lower 8 bits of ecpriSeqid
+    // Update a running CRC register (initial value 0xFFFFFFFF, not yet inverted) with the given bytes
+    static uint32_t update(uint32_t crc, const uint8_t *data, uint64_t length)
+    {
+        return implementation().update(crc, data, length);
+    }
 
-        payload = ecpriPayload;
+    // Compute the final CRC-32 value of a buffer
+    static uint32_t compute(const uint8_t *data, uint64_t length)
+    {
+        return update(0xFFFFFFFF, data, length) ^ 0xFFFFFFFF;
     }
 
-    // Function to retrieve the complete eCPRI packet (header + payload)
-    vector<uint8_t> getPacket()
+    // Name of the implementation selected for this CPU
+    static const char *name()
     {
-        ecpriPacket.insert(ecpriPacket.end(), header.begin(), header.end());   // Insert header
-        ecpriPacket.insert(ecpriPacket.end(), payload.begin(), payload.end()); // Insert payload
+        return implementation().name;
+    }
 
-        return ecpriPacket; // Return the complete eCPRI packet
+    // CRC-32 of the concatenation A+B, given CRC(A), CRC(B) and the length of B (like zlib's crc32_combine)
+    static uint32_t combine(uint32_t crcA, uint32_t crcB, uint64_t lengthB)
+    {
+        return combineWithFactor(crcA, crcB, shiftFactor(lengthB));
     }
-};
 
-// Class representing an Ethernet frame encapsulating eCPRI packets
-class EthernetPacket
-{
-private:
-    // Ethernet configuration and frame components
-    uint32_t minNumOfIFGsPerPacket;                                                   // Minimum number of inter-frame gaps (IFGs)
-    const array<uint8_t, 8> preamble{0xfb, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0xd5}; // Ethernet frame preamble and SFD
-    array<uint8_t, 6> destAddress;                                                    // Destination MAC address
-    array<uint8_t, 6> sourceAddress;                                                  // Source MAC address
-    array<uint8_t, 2> etherSize;                                                      // EtherType/Size field
-    vector<uint8_t> payload;                                                          // Payload (eCPRI packet)
-    array<uint8_t, 4> fcs;                                                            // Frame Check Sequence (FCS)
-    vector<uint8_t> frame;                                                            // Final Ethernet frame
+    // Same as combine(), with the length of B replaced by a factor precomputed once through shiftFactor()
+    static uint32_t combineWithFactor(uint32_t crcA, uint32_t crcB, uint32_t factor)
+    {
+        return multiplyModPoly(factor, crcA) ^ crcB;
+    }
 
-public:
-    // Constructor to initialize the Ethernet packet with given parameters
-    EthernetPacket(const array<uint8_t, 6> &dest, const array<uint8_t, 6> &src, const array<uint8_t, 2> &size, const vector<uint8_t> &data, const uint32_t &MinNumOfIFGsPerPacket)
-        : destAddress(dest), sourceAddress(src), etherSize(size), payload(move(data)), minNumOfIFGsPerPacket(MinNumOfIFGsPerPacket)
+    // x^(8 * length) modulo the CRC polynomial: the operator that appends `length` zero bytes to a CRC
+    static uint32_t shiftFactor(uint64_t length)
+    {
+        const auto &powers = powerTable();
+        uint32_t factor = 0x80000000; // x^0 in the reflected representation
+        unsigned k = 3;               // One byte is x^8 = x^(2^3)
+        while (length)
+        {
+            if (length & 1)
+            {
+                factor = multiplyModPoly(powers[k & 31], factor);
+            }
+            length >>= 1;
+            k++;
+        }
+        return factor;
+    }
+
+    // Table-driven update, usable on any CPU (slicing-by-16, then slicing-by-8, then byte at a time)
+    static uint32_t updateTable(uint32_t crc, const uint8_t *data, uint64_t length)
     {
+        const auto &table = tables();
+
+        while (length >= 16)
+        {
+            uint32_t a = crc ^ load32(data);
+            uint32_t b = load32(data + 4);
+            uint32_t c = load32(data + 8);
+            uint32_t d = load32(data + 12);
+
+            crc = table[15][a & 0xFF] ^ table[14][(a >> 8) & 0xFF] ^ table[13][(a >> 16) & 0xFF] ^ table[12][a >> 24] ^
+                  table[11][b & 0xFF] ^ table[10][(b >> 8) & 0xFF] ^ table[9][(b >> 16) & 0xFF] ^ table[8][b >> 24] ^
+                  table[7][c & 0xFF] ^ table[6][(c >> 8) & 0xFF] ^ table[5][(c >> 16) & 0xFF] ^ table[4][c >> 24] ^
+                  table[3][d & 0xFF] ^ table[2][(d >> 8) & 0xFF] ^ table[1][(d >> 16) & 0xFF] ^ table[0][d >> 24];
+
+            data += 16;
+            length -= 16;
+        }
+
+        if (length >= 8)
+        {
+            uint32_t a = crc ^ load32(data);
+            uint32_t b = load32(data + 4);
+
+            crc = table[7][a & 0xFF] ^ table[6][(a >> 8) & 0xFF] ^ table[5][(a >> 16) & 0xFF] ^ table[4][a >> 24] ^
+                  table[3][b & 0xFF] ^ table[2][(b >> 8) & 0xFF] ^ table[1][(b >> 16) & 0xFF] ^ table[0][b >> 24];
+
+            data += 8;
+            length -= 8;
+        }
+
+        while (length--)
+        {
+            crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+        }
+
+        return crc;
     }
 
-    // Method to calculate CRC-32 (Frame Check Sequence) for the given data
-    array<uint8_t, 4> crc32(const vector<uint8_t> &data)
+    // Every implementation the running CPU supports, the table-driven one first (for the self test)
+    static vector<implementationEntry> available()
     {
-        uint32_t crc = 0xFFFFFFFF;              // Initial CRC value
-        const uint32_t polynomial = 0xEDB88320; // Polynomial used in Ethernet CRC-32
+        vector<implementationEntry> entries{{"slicing-by-16", updateTable}};
+#ifdef HAVE_X86_INTRINSICS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+        {
+            entries.push_back({"pclmulqdq", updatePclmul});
+        }
+#endif
+#ifdef CRC32_HAVE_ARMV8
+#if defined(__linux__)
+        if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+#endif
+        {
+            entries.push_back({"armv8-crc32", updateArmv8});
+        }
+#endif
+        return entries;
+    }
 
-        for (auto byte : data)
+private:
+    // Slicing tables: table[0] is the classic byte table, table[k] advances a byte by k more positions
+    static const array<array<uint32_t, 256>, 16> &tables()
+    {
+        static const array<array<uint32_t, 256>, 16> table = []
         {
-            crc ^= static_cast<uint32_t>(byte); // XOR byte with current CRC value
-            for (int i = 0; i < 8; ++i)
+            array<array<uint32_t, 256>, 16> result{};
+            for (uint32_t i = 0; i < 256; i++)
             {
-                if (crc & 1)
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++)
                 {
-                    crc = (crc >> 1) ^ polynomial;
+                    crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
                 }
-                else
+                result[0][i] = crc;
+            }
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                for (int k = 1; k < 16; k++)
                 {
-                    crc >>= 1;
+                    result[k][i] = (result[k - 1][i] >> 8) ^ result[0][result[k - 1][i] & 0xFF];
                 }
             }
+            return result;
+        }();
+        return table;
+    }
+
+    // Carry-less multiplication of two reflected polynomials modulo the CRC polynomial
+    static uint32_t multiplyModPoly(uint32_t a, uint32_t b)
+    {
+        uint32_t mask = 0x80000000;
+        uint32_t product = 0;
+        while (mask)
+        {
+            if (a & mask)
+            {
+                product ^= b;
+            }
+            mask >>= 1;
+            b = (b & 1) ? (b >> 1) ^ 0xEDB88320 : b >> 1;
         }
-        crc = crc ^ 0xFFFFFFFF; // Final XOR to complete the CRC
+        return product;
+    }
 
-        // Convert the 32-bit CRC result to a 4-byte array
-        array<uint8_t, 4> crcArray;
-        crcArray[0] = static_cast<uint8_t>(crc >> 24);
-        crcArray[1] = static_cast<uint8_t>(crc >> 16);
-        crcArray[2] = static_cast<uint8_t>(crc >> 8);
-        crcArray[3] = static_cast<uint8_t>(crc);
+    // powers[k] = x^(2^k) modulo the CRC polynomial, the period of these powers is 32
+    static const array<uint32_t, 32> &powerTable()
+    {
+        static const array<uint32_t, 32> powers = []
+        {
+            array<uint32_t, 32> result{};
+            result[0] = 0x40000000; // x^1
+            for (int k = 1; k < 32; k++)
+            {
+                result[k] = multiplyModPoly(result[k - 1], result[k - 1]);
+            }
+            return result;
+        }();
+        return powers;
+    }
 
-        return crcArray;
+    // Little-endian 32-bit load that does not depend on host byte order or alignment
+    static uint32_t load32(const uint8_t *p)
+    {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
     }
 
-    // Method to construct the complete Ethernet frame
-    vector<uint8_t> getPacket()
+#ifdef HAVE_X86_INTRINSICS
+    // Fold 64-byte blocks with PCLMULQDQ and Barrett-reduce to 32 bits (Intel "Fast CRC Computation
+    // Using PCLMULQDQ" constants for the bit-reflected polynomial). Tails shorter than 16 bytes use the tables.
+    __attribute__((target("pclmul,sse4.1"))) static uint32_t updatePclmul(uint32_t crc, const uint8_t *data, uint64_t length)
     {
-        // Add Destination MAC to the frame
-        frame.insert(frame.end(), destAddress.begin(), destAddress.end());
+        if (length < 64)
+        {
+            return updateTable(crc, data, length);
+        }
 
-        // Add Source MAC to the frame
-        frame.insert(frame.end(), sourceAddress.begin(), sourceAddress.end());
+        const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+        const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+        const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+        const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+        const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
 
-        // Add EtherSize field to the frame
-        frame.insert(frame.end(), etherSize.begin(), etherSize.end());
+        __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x00));
+        __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x10));
+        __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x20));
+        __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x30));
+        __m128i x5, x6, x7, x8;
 
-        // Add Payload data to the frame
-        frame.insert(frame.end(), payload.begin(), payload.end());
+        x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+        data += 64;
+        length -= 64;
 
-        // Calculate and add Frame Check Sequence (CRC-32) to the frame
-        fcs = crc32(frame);
-        frame.insert(frame.end(), fcs.begin(), fcs.end());
+        // Fold four 128-bit lanes in parallel while at least 64 bytes remain
+        while (length >= 64)
+        {
+            x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+            x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+            x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+            x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+            x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+            x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+            x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+            x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x00)));
+            x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x10)));
+            x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x20)));
+            x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x30)));
+
+            data += 64;
+            length -= 64;
+        }
 
-        // Add Preamble (7 bytes) + Start Frame Delimiter (SFD) (1 byte)
-        frame.insert(frame.begin(), preamble.begin(), preamble.end());
+        // Fold the four lanes into a single 128-bit value
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
 
-        // Insert minimum number of IFGS per packet
-        for (uint32_t i = 0; i < minNumOfIFGsPerPacket; i++)
+        // Fold the remaining whole 16-byte blocks
+        while (length >= 16)
         {
-            frame.push_back(0x07); // Insert IFG byte (0x07)
+            x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+            x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data)));
+
+            data += 16;
+            length -= 16;
         }
 
-        // Ensure the frame has 4-byte alignment by padding with IFG bytes
-        while (frame.size() % 4)
+        // Fold 128 bits down to 64 bits
+        x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_and_si128(x1, mask32);
+        x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5k0, 0x00), x2);
+
+        // Barrett reduction to 32 bits
+        x2 = _mm_and_si128(x1, mask32);
+        x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+        x2 = _mm_and_si128(x2, mask32);
+        x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        crc = static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+
+        return updateTable(crc, data, length);
+    }
+#endif
+
+#ifdef CRC32_HAVE_ARMV8
+    // ARMv8 CRC32 instructions implement the same reflected IEEE 802.3 polynomial, 8 bytes per instruction
+    __attribute__((target("+crc"))) static uint32_t updateArmv8(uint32_t crc, const uint8_t *data, uint64_t length)
+    {
+        while (length >= 8)
         {
-            frame.push_back(0x07);
+            uint64_t word;
+            memcpy(&word, data, sizeof(word)); // AArch64 runs little-endian, as the reflected CRC expects
+            crc = __crc32d(crc, word);
+            data += 8;
+            length -= 8;
         }
+        while (length--)
+        {
+            crc = __crc32b(crc, *data++);
+        }
+        return crc;
+    }
+#endif
 
-        return frame; // Return the constructed Ethernet frame
+    // Pick the fastest implementation supported by the running CPU
+    static const implementationEntry &implementation()
+    {
+        static const implementationEntry selected = []
+        {
+#ifdef HAVE_X86_INTRINSICS
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+            {
+                return implementationEntry{"pclmulqdq", updatePclmul};
+            }
+#endif
+#ifdef CRC32_HAVE_ARMV8
+#if defined(__linux__)
+            if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+#endif
+            {
+                return implementationEntry{"armv8-crc32", updateArmv8};
+            }
+#endif
+            return implementationEntry{"slicing-by-16", updateTable};
+        }();
+        return selected;
     }
 };
 
-// Class that handles streaming packets and generating the full packet stream
-class packetStreaming
+// Cache of payload segment CRCs, keyed by the IQ source, the segment's start offset in it and its length.
+// With a fixed payload the same IQ slices come back every few packets, so the FCS of a frame only
+// needs the CRC of its headers combined with the cached CRC of its payload.
+class payloadCrcCache
 {
 private:
-    vector<uint8_t> fullPacket; // Complete packet stream, including all bursts and IFGs
-    vector<int8_t> iqSamples;   // IQ samples used in the packets
-    vector<uint8_t> silentIFGs; // IFG bytes for the stream
+    struct segmentKey
+    {
+        uint64_t source;
+        uint64_t offset;
+        uint64_t length;
+
+        bool operator==(const segmentKey &other) const
+        {
+            return source == other.source && offset == other.offset && length == other.length;
+        }
+    };
+
+    struct segmentKeyHash
+    {
+        size_t operator()(const segmentKey &key) const
+        {
+            return hash<uint64_t>()(key.offset ^ (key.length << 40) ^ (key.source * 0x9E3779B97F4A7C15ULL));
+        }
+    };
+
+    unordered_map<segmentKey, uint32_t, segmentKeyHash> entries; // CRC-32 of each segment
+    size_t maxEntries;                                            // Upper bound on cached segments
+    uint64_t hits{0};
+    uint64_t misses{0};
+
+public:
+    payloadCrcCache(size_t MaxEntries = 1 << 20) : maxEntries(MaxEntries)
+    {
+    }
+
+    // Return the CRC of the segment at `offset` of IQ source `source`, computing and remembering it on a miss
+    uint32_t get(uint64_t source, uint64_t offset, const uint8_t *segment, uint64_t length)
+    {
+        segmentKey key{source, offset, length};
+        auto entry = entries.find(key);
+        if (entry != entries.end())
+        {
+            hits++;
+            return entry->second;
+        }
+
+        misses++;
+        uint32_t crc = crc32Engine::compute(segment, length);
+        if (entries.size() < maxEntries)
+        {
+            entries.emplace(key, crc);
+        }
+        return crc;
+    }
+
+    // Add the hit and miss counters of another cache (e.g. one owned by a worker thread)
+    void mergeCounters(const payloadCrcCache &other)
+    {
+        hits += other.hits;
+        misses += other.misses;
+    }
+
+    uint64_t getHits() const { return hits; }
+    uint64_t getMisses() const { return misses; }
+};
+
+// Distinct frame bodies of a fixed-payload stream. The IQ slice of packet N starts at
+// (N * samplesPerPacket) % iqSamples.size(), so the slices repeat every
+// iqSamples.size() / gcd(samplesPerPacket, iqSamples.size()) packets. Each distinct slice is built once
+// (compressed when compression is on) together with its CRC, and the hot path only copies it and stamps
+// the headers and the FCS.
+class frameTemplateCache
+{
+private:
+    vector<uint8_t> bodies; // `templates` encoded IQ slices of `bodySize` bytes, one per packet of the period
+    vector<uint32_t> crcs;  // CRC-32 of each encoded slice
+    uint64_t period{0};     // Number of packets after which the IQ slices repeat
+    uint64_t templates{0};  // Number of slices actually built (the period, capped by the packet count)
+    uint64_t bodySize{0};
+
+public:
+    // Find the period and pre-build the distinct slices. Returns false (cache disabled) when the slices
+    // never repeat within the stream or would take more than `maxBytes` of memory.
+    template <typename Encoder>
+    bool build(const vector<int8_t> &iqSamples, uint64_t samplesPerPacket, uint64_t totalPackets, uint64_t maxBytes, const Encoder &encoder)
+    {
+        uint64_t sizeOfSamples = iqSamples.size();
+        uint64_t prbs = samplesPerPacket / Encoder::valuesPerPrb;
+        period = sizeOfSamples / gcd(samplesPerPacket % sizeOfSamples, sizeOfSamples);
+        templates = min(period, totalPackets);
+        bodySize = encoder.payloadSize(prbs);
+
+        if (period >= totalPackets || templates * bodySize > maxBytes)
+        {
+            templates = 0;
+            return false;
+        }
+
+        bodies.resize(templates * bodySize);
+        crcs.resize(templates);
+        vector<int8_t> slice(samplesPerPacket);
+        for (uint64_t t = 0; t < templates; t++)
+        {
+            // Take the slice with wrap-around, exactly as the packet would have taken it
+            uint8_t *body = bodies.data() + t * bodySize;
+            uint64_t offset = (t * samplesPerPacket) % sizeOfSamples;
+            for (uint64_t copied = 0; copied < samplesPerPacket;)
+            {
+                uint64_t run = min(samplesPerPacket - copied, sizeOfSamples - offset);
+                memcpy(slice.data() + copied, iqSamples.data() + offset, run);
+                copied += run;
+                offset = 0;
+            }
+            encoder.encode(slice.data(), prbs, body);
+            crcs[t] = crc32Engine::compute(body, bodySize);
+        }
+        return true;
+    }
+
+    bool enabled() const { return templates > 0; }
+
+    // Template index used by a packet
+    uint64_t indexOf(uint64_t packetNo) const { return packetNo % period; }
+
+    const uint8_t *body(uint64_t index) const { return bodies.data() + index * bodySize; }
+
+    const uint32_t *crc(uint64_t index) const { return &crcs[index]; }
+
+    uint64_t getPeriod() const { return period; }
+    uint64_t getTemplates() const { return templates; }
+    uint64_t getMemory() const { return bodies.size(); }
+};
+
+// Read-only view of a whole file: memory-mapped on POSIX systems, read into memory elsewhere
+class mappedFile
+{
+private:
+    const char *bytes{nullptr};
+    uint64_t length{0};
+    vector<char> copy; // Contents when the file cannot be mapped
+#ifndef _WIN32
+    void *mapping{nullptr};
+#endif
+
+public:
+    mappedFile(const string &fileName)
+    {
+#ifndef _WIN32
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw runtime_error("Failed to open " + fileName);
+        }
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size > 0)
+        {
+            void *address = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED)
+            {
+                mapping = address;
+                bytes = static_cast<const char *>(address);
+                length = static_cast<uint64_t>(size);
+                madvise(mapping, length, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+        if (mapping || size == 0)
+        {
+            return;
+        }
+#endif
+        ifstream file(fileName, ios::in | ios::binary);
+        if (!file)
+        {
+            throw runtime_error("Failed to open " + fileName);
+        }
+        copy.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        bytes = copy.data();
+        length = copy.size();
+    }
+
+    ~mappedFile()
+    {
+#ifndef _WIN32
+        if (mapping)
+        {
+            munmap(mapping, length);
+        }
+#endif
+    }
+
+    mappedFile(const mappedFile &) = delete;
+    mappedFile &operator=(const mappedFile &) = delete;
+
+    const char *data() const { return bytes; }
+    uint64_t size() const { return length; }
+};
+
+// Loads IQ sample files: one "I Q" pair of integers per line. Lines are found with a vectorized newline
+// scan and their numbers parsed with from_chars, with the rules of the original stringstream parser: a
+// line contributes its first two integers, lines without two integers are skipped, and every value is
+// stored modulo 256. Parsed samples can be kept in a packed "<file>.iqbin" sidecar, keyed by the size and
+// modification time of the text file, so later runs load them with a single read.
+class iqSampleLoader
+{
+private:
+    static constexpr char cacheMagic[8] = {'I', 'Q', 'B', 'I', 'N', '1', 0, 0};
+
+    // Cache header: magic, size and modification time of the text file, number of samples
+    struct cacheHeader
+    {
+        char magic[8];
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t samples;
+    };
+
+public:
+    static vector<int8_t> load(const string &fileName, bool useCache)
+    {
+        vector<int8_t> samples;
+        if (useCache && loadCache(fileName, samples))
+        {
+            console() << "IQ samples loaded from " << fileName << ".iqbin" << endl;
+            return samples;
+        }
+
+        mappedFile file(fileName);
+        samples = parse(file.data(), file.size());
+
+        if (useCache)
+        {
+            storeCache(fileName, samples);
+        }
+        return samples;
+    }
+
+    static vector<int8_t> parse(const char *text, uint64_t length)
+    {
+        vector<int8_t> samples;
+        samples.reserve(length / 3); // A line holds at least 4 characters for 2 samples
+        const char *end = text + length;
+        while (text < end)
+        {
+            const char *lineEnd = findNewline(text, end);
+            int first, second;
+            const char *cursor = parseInt(text, lineEnd, first);
+            if (cursor && parseInt(cursor, lineEnd, second))
+            {
+                samples.push_back(static_cast<int8_t>(first));
+                samples.push_back(static_cast<int8_t>(second));
+            }
+            text = lineEnd + (lineEnd < end);
+        }
+        return samples;
+    }
+
+private:
+    static bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    // Skip blanks and parse one integer like operator>> does; nullptr when there is none
+    static const char *parseInt(const char *text, const char *end, int &value)
+    {
+        while (text < end && isBlank(*text))
+        {
+            text++;
+        }
+        if (text + 1 < end && *text == '+' && *(text + 1) != '-')
+        {
+            text++;
+        }
+        auto result = from_chars(text, end, value);
+        return result.ec == errc() ? result.ptr : nullptr;
+    }
+
+    static const char *findNewlineScalar(const char *text, const char *end)
+    {
+        const void *found = memchr(text, '\n', end - text);
+        return found ? static_cast<const char *>(found) : end;
+    }
+
+#ifdef HAVE_X86_INTRINSICS
+    // Compare 32 characters at a time against '\n'
+    __attribute__((target("avx2"))) static const char *findNewlineAvx2(const char *text, const char *end)
+    {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        for (; end - text >= 32; text += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+            if (mask)
+            {
+                return text + __builtin_ctz(mask);
+            }
+        }
+        return findNewlineScalar(text, end);
+    }
+#endif
+
+    static const char *findNewline(const char *text, const char *end)
+    {
+        static const char *(*const selected)(const char *, const char *) = []
+        {
+#ifdef HAVE_X86_INTRINSICS
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return findNewlineAvx2;
+            }
+#endif
+            return findNewlineScalar;
+        }();
+        return selected(text, end);
+    }
+
+    static bool sourceStamp(const string &fileName, uint64_t &size, int64_t &time)
+    {
+        error_code error;
+        size = filesystem::file_size(fileName, error);
+        if (error)
+        {
+            return false;
+        }
+        time = static_cast<int64_t>(filesystem::last_write_time(fileName, error).time_since_epoch().count());
+        return !error;
+    }
+
+    static bool loadCache(const string &fileName, vector<int8_t> &samples)
+    {
+        uint64_t size;
+        int64_t time;
+        ifstream cache(fileName + ".iqbin", ios::in | ios::binary);
+        cacheHeader header;
+        if (!cache || !sourceStamp(fileName, size, time) ||
+            !cache.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+            memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.sourceSize != size || header.sourceTime != time)
+        {
+            return false;
+        }
+        // A truncated or corrupted cache must not size the vector; it is parsed again instead
+        error_code error;
+        uint64_t cacheSize = filesystem::file_size(fileName + ".iqbin", error);
+        if (error || cacheSize < sizeof(header) || header.samples != cacheSize - sizeof(header))
+        {
+            return false;
+        }
+        samples.resize(header.samples);
+        return static_cast<bool>(cache.read(reinterpret_cast<char *>(samples.data()), static_cast<streamsize>(samples.size())));
+    }
+
+    // Best effort: a cache that cannot be written only costs the next run a parse
+    static void storeCache(const string &fileName, const vector<int8_t> &samples)
+    {
+        cacheHeader header;
+        memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+        header.samples = samples.size();
+        if (!sourceStamp(fileName, header.sourceSize, header.sourceTime))
+        {
+            return;
+        }
+        ofstream cache(fileName + ".iqbin", ios::out | ios::binary | ios::trunc);
+        cache.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        cache.write(reinterpret_cast<const char *>(samples.data()), static_cast<streamsize>(samples.size()));
+    }
+};
+
+class parseConfigurations
+{
+public:
+    // Ethernet Configuration parameters parsed from the file
+    uint64_t LineRate;             // Ethernet line rate (in Gbps)
+    uint64_t CaptureSizeMs;        // Capture duration in milliseconds
+    uint8_t MinNumOfIFGsPerPacket; // Minimum number of inter-frame gaps (IFGs) per packet
+    uint64_t DestAddress;          // Destination MAC address
+    uint64_t SourceAddress;        // Source MAC address
+    uint16_t MaxPacketSize;        // Maximum packet size (in bytes)
+
+    // ORAN Configuration parameters parsed from the file
+    uint8_t SCS;                 // Subcarrier spacing
+    uint16_t MaxNrb;             // Maximum number of resource blocks
+    uint16_t NrbPerPacket;       // Number of resource blocks per packet
+    string PayloadType;          // Type of payload: "fixed" or "random"
+    bool HasSeed{false};         // Whether Oran.Seed was given
+    uint64_t Seed{0};            // Seed of the random payload, so a random stream can be reproduced
+    bool PayloadCache{false};    // Keep the parsed IQ samples in a binary "<Oran.Payload>.iqbin" cache
+    uint8_t CompressionWidth{0}; // BFP mantissa width in bits, 0 for uncompressed samples
+    uint16_t NumEaxc{1};         // eAxCs (antenna streams) per carrier
+    uint16_t NumCarriers{1};     // Component carriers
+    vector<uint16_t> EaxcIds;    // RU port ID of each eAxC of a carrier (0 to NumEaxc - 1 by default)
+    vector<uint16_t> VlanIds;    // VLAN ID of each flow, repeated over the flows (empty = untagged frames)
+    vector<uint8_t> VlanPcps;    // VLAN priority code point of each flow, repeated over the flows
+    bool ControlPlane{false};    // Send a C-plane (section type 1) message per flow and slot ahead of its U-plane packets
+    uint64_t CplaneAdvanceUs{0}; // How far the C-plane message of a slot precedes the slot's first symbol
+
+    vector<string> PayloadFiles;      // Files of Oran.Payload
+    vector<vector<int8_t>> iqSamples; // IQ Samples extracted from each file of Oran.Payload
+
+    // Constructor that reads the configuration values from a file. Entries of `overrides` replace the
+    // values of the file (or add missing keys), e.g. to run one file with several line rates. Without
+    // `loadPayload` the IQ files are not read.
+    parseConfigurations(string fileName, const map<string, string> &overrides = {}, bool loadPayload = true)
+    {
+        console() << "========= Start Parsing =========" << endl;
+
+        // Open the configuration file for reading
+        ifstream MyReadFile(fileName);
+
+        // Check if the file opened successfully
+        if (!MyReadFile)
+        {
+            throw runtime_error("Failed to open configuration file!");
+        }
+
+        // String to hold each line from the configuration file
+        string line;
+
+        // Create a map to store key-value pairs from the file
+        map<string, string> config;
+
+        // Read the file line by line
+        while (getline(MyReadFile, line))
+        {
+            // Skip empty lines
+            if (line.empty())
+            {
+                continue;
+            }
+
+            // Remove all whitespace characters from the line
+            line.erase(remove_if(line.begin(), line.end(), [](unsigned char x)
+                                 { return isspace(x); }),
+                       line.end());
+
+            // Remove comments (anything after "//")
+            auto comment_pos = line.find("//");
+            if (comment_pos != string::npos)
+            {
+                line.erase(line.begin() + line.find("//"), line.end());
+            }
+
+            // Split the line at the '=' sign
+            auto key = line.substr(0, line.find('='));
+            auto valueStr = line.substr(line.find('=') + 1);
+
+            // Store the key-value pair in the map
+            config[key] = valueStr;
+
+            console() << key << ": " << valueStr << endl;
+        }
+
+        for (const auto &entry : overrides)
+        {
+            config[entry.first] = entry.second;
+            console() << entry.first << ": " << entry.second << " (override)" << endl;
+        }
+
+        console() << "========= Done Parsing =========" << endl;
+
+        // Close the file
+        MyReadFile.close();
+
+        // Set the configuration fields from the map values
+        LineRate = convertIntoInteger(config["Eth.LineRate"]);
+        CaptureSizeMs = convertIntoInteger(config["Eth.CaptureSizeMs"]);
+        MinNumOfIFGsPerPacket = static_cast<uint8_t>(convertIntoInteger(config["Eth.MinNumOfIFGsPerPacket"]));
+        DestAddress = convertIntoInteger(config["Eth.DestAddress"]);
+        SourceAddress = convertIntoInteger(config["Eth.SourceAddress"]);
+        MaxPacketSize = static_cast<uint16_t>(convertIntoInteger(config["Eth.MaxPacketSize"]));
+
+        SCS = static_cast<uint8_t>(convertIntoInteger(config["Oran.SCS"]));
+        MaxNrb = static_cast<uint16_t>(convertIntoInteger(config["Oran.MaxNrb"]));
+        NrbPerPacket = static_cast<uint16_t>(convertIntoInteger(config["Oran.NrbPerPacket"]));
+        PayloadType = config["Oran.PayloadType"];
+        HasSeed = config.count("Oran.Seed") > 0;
+        if (HasSeed)
+        {
+            Seed = convertIntoInteger(config["Oran.Seed"]);
+        }
+
+        PayloadCache = config.count("Oran.PayloadCache") > 0 && convertIntoInteger(config["Oran.PayloadCache"]) != 0;
+
+        // Oran.Compression is "none" or "bfp<mantissa bits>", e.g. bfp9
+        string compression = config.count("Oran.Compression") ? config["Oran.Compression"] : "none";
+        if (compression.rfind("bfp", 0) == 0 && compression.size() > 3 && compression.find_first_not_of("0123456789", 3) == string::npos)
+        {
+            uint64_t width = convertIntoInteger(compression.substr(3));
+            if (width < 1 || width > 16)
+            {
+                throw runtime_error("Wrong Compression");
+            }
+            CompressionWidth = static_cast<uint8_t>(width);
+        }
+        else if (compression != "none")
+        {
+            throw runtime_error("Wrong Compression");
+        }
+
+        // Flows: NumEaxc eAxCs on each of NumCarriers carriers, optionally VLAN tagged
+        if (config.count("Oran.NumEaxc"))
+        {
+            NumEaxc = static_cast<uint16_t>(convertIntoInteger(config["Oran.NumEaxc"]));
+        }
+        if (config.count("Oran.NumCarriers"))
+        {
+            NumCarriers = static_cast<uint16_t>(convertIntoInteger(config["Oran.NumCarriers"]));
+        }
+        if (NumEaxc < 1 || NumEaxc > 256 || NumCarriers < 1 || NumCarriers > 256)
+        {
+            throw runtime_error("Wrong NumEaxc or NumCarriers");
+        }
+        for (const string &id : config.count("Oran.EaxcIds") ? splitList(config["Oran.EaxcIds"]) : vector<string>{})
+        {
+            EaxcIds.push_back(static_cast<uint16_t>(convertIntoInteger(id)));
+        }
+        if (EaxcIds.empty())
+        {
+            for (uint16_t id = 0; id < NumEaxc; id++)
+            {
+                EaxcIds.push_back(id);
+            }
+        }
+        if (EaxcIds.size() != NumEaxc || *max_element(EaxcIds.begin(), EaxcIds.end()) > 0xFF)
+        {
+            throw runtime_error("Wrong EaxcIds");
+        }
+        for (const string &id : config.count("Eth.VlanId") ? splitList(config["Eth.VlanId"]) : vector<string>{})
+        {
+            uint64_t vlanId = convertIntoInteger(id);
+            if (vlanId > 0xFFF)
+            {
+                throw runtime_error("Wrong VlanId");
+            }
+            VlanIds.push_back(static_cast<uint16_t>(vlanId));
+        }
+        for (const string &pcp : config.count("Eth.VlanPcp") ? splitList(config["Eth.VlanPcp"]) : vector<string>{"0"})
+        {
+            uint64_t priority = convertIntoInteger(pcp);
+            if (priority > 7)
+            {
+                throw runtime_error("Wrong VlanPcp");
+            }
+            VlanPcps.push_back(static_cast<uint8_t>(priority));
+        }
+
+        // C-plane messages, sent Oran.CplaneAdvanceUs microseconds ahead of their slot
+        ControlPlane = config.count("Oran.ControlPlane") > 0 && convertIntoInteger(config["Oran.ControlPlane"]) != 0;
+        if (config.count("Oran.CplaneAdvanceUs"))
+        {
+            CplaneAdvanceUs = convertIntoInteger(config["Oran.CplaneAdvanceUs"]);
+        }
+
+        PayloadFiles = splitList(config["Oran.Payload"]);
+        for (const string &payload : loadPayload ? PayloadFiles : vector<string>{})
+        {
+            iqSamples.push_back(parseIQSamples(payload));
+        }
+    }
+
+    // Function to parse IQ Samples from a file (two integers per line), through the binary cache if enabled
+    vector<int8_t> parseIQSamples(string fileName)
+    {
+        scopedStage timer{stage::iqLoad};
+        return iqSampleLoader::load(fileName, PayloadCache);
+    }
+};
+
+// Counter-based random IQ payload (Philox4x32-10). Every 16-byte block of a packet is the Philox block
+// of the counter (block index, packet number) under a key derived from the seed, so the bytes of any
+// packet are a pure function of (seed, packetNo). Packets can therefore be generated on demand, on any
+// thread and in any order, and a given seed always reproduces the same stream. With AVX2 eight blocks
+// are computed at a time.
+class randomIqGenerator
+{
+private:
+    static constexpr uint32_t multiplier0 = 0xD2511F53;
+    static constexpr uint32_t multiplier1 = 0xCD9E8D57;
+    static constexpr uint32_t weyl0 = 0x9E3779B9;
+    static constexpr uint32_t weyl1 = 0xBB67AE85;
+    static constexpr int rounds = 10;
+
+    uint32_t key0;
+    uint32_t key1;
+
+public:
+    randomIqGenerator(uint64_t seed = 0) : key0(static_cast<uint32_t>(seed)), key1(static_cast<uint32_t>(seed >> 32))
+    {
+    }
+
+    // Philox4x32-10 block of a 128-bit counter
+    static array<uint32_t, 4> block(array<uint32_t, 4> counter, uint32_t k0, uint32_t k1)
+    {
+        for (int round = 0; round < rounds; round++)
+        {
+            uint64_t product0 = uint64_t(multiplier0) * counter[0];
+            uint64_t product1 = uint64_t(multiplier1) * counter[2];
+            counter = {static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ k0, static_cast<uint32_t>(product1),
+                       static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ k1, static_cast<uint32_t>(product0)};
+            k0 += weyl0;
+            k1 += weyl1;
+        }
+        return counter;
+    }
+
+    // Write the first `count` random IQ bytes of packet `packetNo`
+    void fill(uint64_t packetNo, uint8_t *destination, uint64_t count) const
+    {
+        uint64_t blocks = count / 16;
+        uint64_t done = kernel()(key0, key1, packetNo, destination, blocks);
+        for (uint64_t index = done; index < blocks; index++)
+        {
+            storeBlock(index, packetNo, destination + 16 * index);
+        }
+        if (count % 16)
+        {
+            uint8_t tail[16];
+            storeBlock(blocks, packetNo, tail);
+            memcpy(destination + 16 * blocks, tail, count % 16);
+        }
+    }
+
+    // fill() without the vector kernel, the reference for the self test
+    void fillScalar(uint64_t packetNo, uint8_t *destination, uint64_t count) const
+    {
+        uint64_t blocks = count / 16;
+        for (uint64_t index = 0; index < blocks; index++)
+        {
+            storeBlock(index, packetNo, destination + 16 * index);
+        }
+        if (count % 16)
+        {
+            uint8_t tail[16];
+            storeBlock(blocks, packetNo, tail);
+            memcpy(destination + 16 * blocks, tail, count % 16);
+        }
+    }
+
+    // Whether fill() uses a vector kernel on the running CPU
+    static bool vectorized()
+    {
+        return kernel() != fillNone;
+    }
+
+private:
+    void storeBlock(uint64_t index, uint64_t packetNo, uint8_t *destination) const
+    {
+        array<uint32_t, 4> words = block({static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32),
+                                          static_cast<uint32_t>(packetNo), static_cast<uint32_t>(packetNo >> 32)},
+                                         key0, key1);
+        memcpy(destination, words.data(), 16); // Host byte order, like the vector kernel
+    }
+
+    // Kernels fill a prefix of the whole blocks of a packet and return how many blocks they wrote
+    static uint64_t fillNone(uint32_t, uint32_t, uint64_t, uint8_t *, uint64_t)
+    {
+        return 0;
+    }
+
+#ifdef HAVE_X86_INTRINSICS
+    // 32x32 -> 64-bit products of all eight lanes, split into their low and high halves
+    __attribute__((target("avx2"))) static inline void multiplyHiLo(__m256i x, __m256i multiplier, __m256i &low, __m256i &high)
+    {
+        __m256i even = _mm256_mul_epu32(x, multiplier);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), multiplier);
+        low = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        high = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    }
+
+    // Eight blocks per iteration, one counter word per register, transposed back to 16-byte blocks
+    __attribute__((target("avx2"))) static uint64_t fillAvx2(uint32_t k0, uint32_t k1, uint64_t packetNo, uint8_t *destination, uint64_t blocks)
+    {
+        const __m256i m0 = _mm256_set1_epi32(static_cast<int>(multiplier0));
+        const __m256i m1 = _mm256_set1_epi32(static_cast<int>(multiplier1));
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        uint64_t index = 0;
+        for (; index + 8 <= blocks && index + 8 <= 0xFFFFFFFFULL; index += 8, destination += 128)
+        {
+            __m256i x0 = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(index)), lanes);
+            __m256i x1 = _mm256_setzero_si256();
+            __m256i x2 = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(packetNo)));
+            __m256i x3 = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(packetNo >> 32)));
+            uint32_t roundKey0 = k0;
+            uint32_t roundKey1 = k1;
+
+            for (int round = 0; round < rounds; round++)
+            {
+                __m256i low0, high0, low1, high1;
+                multiplyHiLo(x0, m0, low0, high0);
+                multiplyHiLo(x2, m1, low1, high1);
+                x0 = _mm256_xor_si256(_mm256_xor_si256(high1, x1), _mm256_set1_epi32(static_cast<int>(roundKey0)));
+                x1 = low1;
+                x2 = _mm256_xor_si256(_mm256_xor_si256(high0, x3), _mm256_set1_epi32(static_cast<int>(roundKey1)));
+                x3 = low0;
+                roundKey0 += weyl0;
+                roundKey1 += weyl1;
+            }
+
+            // Transpose: each 128-bit half of t0..t3 ends up holding one whole block
+            __m256i a = _mm256_unpacklo_epi32(x0, x1);
+            __m256i b = _mm256_unpacklo_epi32(x2, x3);
+            __m256i c = _mm256_unpackhi_epi32(x0, x1);
+            __m256i d = _mm256_unpackhi_epi32(x2, x3);
+            __m256i t0 = _mm256_unpacklo_epi64(a, b); // Blocks 0 and 4
+            __m256i t1 = _mm256_unpackhi_epi64(a, b); // Blocks 1 and 5
+            __m256i t2 = _mm256_unpacklo_epi64(c, d); // Blocks 2 and 6
+            __m256i t3 = _mm256_unpackhi_epi64(c, d); // Blocks 3 and 7
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + 0), _mm256_permute2x128_si256(t0, t1, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + 32), _mm256_permute2x128_si256(t2, t3, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + 64), _mm256_permute2x128_si256(t0, t1, 0x31));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + 96), _mm256_permute2x128_si256(t2, t3, 0x31));
+        }
+        return index;
+    }
+#endif
+
+    // Pick the block kernel supported by the running CPU
+    static uint64_t (*kernel())(uint32_t, uint32_t, uint64_t, uint8_t *, uint64_t)
+    {
+        static uint64_t (*const selected)(uint32_t, uint32_t, uint64_t, uint8_t *, uint64_t) = []
+        {
+#ifdef HAVE_X86_INTRINSICS
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return fillAvx2;
+            }
+#endif
+            return fillNone;
+        }();
+        return selected;
+    }
+};
+
+// O-RAN U-plane block floating point compression (udCompMeth = 1). The 8-bit IQ samples are taken as the
+// high byte of 16-bit samples. Each PRB (12 REs, 24 values) gets the smallest exponent that fits all of
+// its values in `iqWidth`-bit two's complement mantissas. It is sent as a udCompParam byte holding that
+// exponent followed by the mantissas packed MSB first. A section starts with udCompHdr (udIqWidth,
+// udCompMeth) and a reserved byte. An iqWidth of 0 leaves the samples uncompressed.
+class bfpCompressor
+{
+public:
+    static constexpr uint64_t valuesPerPrb = 2 * RE_PER_RB;
+    static constexpr uint64_t sectionHeaderSize = 2; // udCompHdr and its reserved byte
+
+private:
+    uint8_t iqWidth;
+
+public:
+    bfpCompressor(uint8_t IqWidth = 0) : iqWidth(IqWidth)
+    {
+        if (iqWidth > 16)
+        {
+            throw runtime_error("Compression mantissa width must be between 1 and 16 bits");
+        }
+    }
+
+    bool enabled() const { return iqWidth != 0; }
+    uint8_t getIqWidth() const { return iqWidth; }
+
+    // Bytes a section of `prbs` PRBs takes in the packet
+    uint64_t payloadSize(uint64_t prbs) const
+    {
+        return enabled() ? sectionHeaderSize + prbs * (1 + 3 * uint64_t(iqWidth)) : prbs * valuesPerPrb;
+    }
+
+    // Write the section of `prbs` PRBs of 8-bit samples at `destination`. Returns the bytes written.
+    uint64_t encode(const int8_t *samples, uint64_t prbs, uint8_t *destination) const
+    {
+        if (!enabled())
+        {
+            memcpy(destination, samples, prbs * valuesPerPrb);
+            return prbs * valuesPerPrb;
+        }
+
+        uint8_t *out = destination;
+        *out++ = static_cast<uint8_t>(((iqWidth & 0x0F) << 4) | 0x01); // udIqWidth (16 is sent as 0), udCompMeth = BFP
+        *out++ = 0x00;                                                   // reserved
+        int16_t mantissas[valuesPerPrb];
+        for (uint64_t prb = 0; prb < prbs; prb++, samples += valuesPerPrb)
+        {
+            uint8_t exponent = kernel()(samples, iqWidth, mantissas);
+            *out++ = exponent; // udCompParam: reserved (4 bits), exponent (4 bits)
+            out = packMantissas(mantissas, out);
+        }
+        return out - destination;
+    }
+
+    // Exponent of a PRB: how far its largest magnitude has to be shifted to fit `width`-bit mantissas
+    static uint8_t exponentFor(uint16_t largestMagnitude, uint8_t width)
+    {
+        int needed = 1; // Sign bit
+        for (uint16_t m = largestMagnitude; m; m >>= 1)
+        {
+            needed++;
+        }
+        return static_cast<uint8_t>(needed > width ? needed - width : 0);
+    }
+
+private:
+    // Pack 24 mantissas of iqWidth bits each, MSB first, into 3 * iqWidth bytes
+    uint8_t *packMantissas(const int16_t *mantissas, uint8_t *out) const
+    {
+        if (iqWidth == 8)
+        {
+            for (uint64_t i = 0; i < valuesPerPrb; i++)
+            {
+                out[i] = static_cast<uint8_t>(mantissas[i]);
+            }
+            return out + valuesPerPrb;
+        }
+
+        const uint32_t mask = (1u << iqWidth) - 1;
+        uint64_t bits = 0;
+        int pending = 0;
+        for (uint64_t i = 0; i < valuesPerPrb; i++)
+        {
+            bits = (bits << iqWidth) | (static_cast<uint32_t>(mantissas[i]) & mask);
+            pending += iqWidth;
+            while (pending >= 8)
+            {
+                pending -= 8;
+                *out++ = static_cast<uint8_t>(bits >> pending);
+            }
+        }
+        return out; // 24 * iqWidth is a multiple of 8, so nothing is left pending
+    }
+
+    // Find the exponent of one PRB and shift its 16-bit values down to mantissas
+    static uint8_t shiftPrbScalar(const int8_t *samples, uint8_t width, int16_t *mantissas)
+    {
+        uint16_t largest = 0;
+        for (uint64_t i = 0; i < valuesPerPrb; i++)
+        {
+            int16_t value = static_cast<int16_t>(samples[i] * 256);
+            largest = max<uint16_t>(largest, static_cast<uint16_t>(value ^ (value >> 15))); // |v| for v >= 0, |v| - 1 below
+        }
+        uint8_t exponent = exponentFor(largest, width);
+        for (uint64_t i = 0; i < valuesPerPrb; i++)
+        {
+            mantissas[i] = static_cast<int16_t>(static_cast<int16_t>(samples[i] * 256) >> exponent);
+        }
+        return exponent;
+    }
+
+#ifdef HAVE_X86_INTRINSICS
+    // Widen the 24 samples to 16 bits, reduce their magnitudes with a max tree and shift them all at once
+    __attribute__((target("avx2"))) static uint8_t shiftPrbAvx2(const int8_t *samples, uint8_t width, int16_t *mantissas)
+    {
+        __m256i first = _mm256_slli_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(samples))), 8);
+        __m128i second = _mm_slli_epi16(_mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(samples + 16))), 8);
+
+        __m256i firstMagnitude = _mm256_xor_si256(first, _mm256_srai_epi16(first, 15));
+        __m128i secondMagnitude = _mm_xor_si128(second, _mm_srai_epi16(second, 15));
+        __m128i largest = _mm_max_epi16(_mm_max_epi16(_mm256_castsi256_si128(firstMagnitude), _mm256_extracti128_si256(firstMagnitude, 1)), secondMagnitude);
+        largest = _mm_max_epi16(largest, _mm_srli_si128(largest, 8));
+        largest = _mm_max_epi16(largest, _mm_srli_si128(largest, 4));
+        largest = _mm_max_epi16(largest, _mm_srli_si128(largest, 2));
+
+        uint8_t exponent = exponentFor(static_cast<uint16_t>(_mm_extract_epi16(largest, 0)), width);
+        __m128i count = _mm_cvtsi32_si128(exponent);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(mantissas), _mm256_sra_epi16(first, count));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(mantissas + 16), _mm_sra_epi16(second, count));
+        return exponent;
+    }
+#endif
+
+    // Pick the PRB kernel supported by the running CPU
+    static uint8_t (*kernel())(const int8_t *, uint8_t, int16_t *)
+    {
+        static uint8_t (*const selected)(const int8_t *, uint8_t, int16_t *) = []
+        {
+#ifdef HAVE_X86_INTRINSICS
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return shiftPrbAvx2;
+            }
+#endif
+            return shiftPrbScalar;
+        }();
+        return selected;
+    }
+};
+
+// A field of a protocol header: its offset in bits from the first (most significant) bit of the header
+// and its width in bits
+template <uint32_t Offset, uint32_t Width>
+struct bitField
+{
+    static constexpr uint32_t offset = Offset;
+    static constexpr uint32_t width = Width;
+    static constexpr uint64_t mask = Width >= 64 ? ~0ULL : (1ULL << Width) - 1;
+};
+
+// Layout of a big-endian header of up to 8 bytes, described once by its fields in wire order. pack()
+// places every value in a single 64-bit word with shifts and masks only, so fields that are constant at
+// the call site fold away at compile time, and store() writes the word as `Bytes` big-endian bytes with
+// one byte swap and a single store.
+template <size_t Bytes, typename... Fields>
+struct headerLayout
+{
+    static constexpr size_t size = Bytes;
+    static constexpr uint32_t bits = 8 * Bytes;
+    static_assert(Bytes > 0 && Bytes <= 8, "a header layout packs into a single 64-bit word");
+    static_assert(((Fields::width > 0 && Fields::offset + Fields::width <= bits) && ...), "field outside the header");
+
+    // Value already masked and shifted to the position of Field in the word
+    template <typename Field>
+    static constexpr uint64_t place(uint64_t value)
+    {
+        return (value & Field::mask) << (bits - Field::offset - Field::width);
+    }
+
+    // Whether no two fields share a bit
+    static constexpr bool disjoint()
+    {
+        uint64_t used = 0;
+        bool separate = true;
+        ((separate = separate && (used & place<Fields>(Fields::mask)) == 0, used |= place<Fields>(Fields::mask)), ...);
+        return separate;
+    }
+    static_assert(disjoint(), "overlapping fields");
+
+    // Pack one value per field, given in the order the fields are declared
+    template <typename... Values>
+    static constexpr uint64_t pack(Values... values)
+    {
+        static_assert(sizeof...(Values) == sizeof...(Fields), "one value per field");
+        return (place<Fields>(static_cast<uint64_t>(values)) | ... | 0ULL);
+    }
+
+    static void store(uint8_t *destination, uint64_t word)
+    {
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint64_t wire = __builtin_bswap64(word << (64 - bits));
+        memcpy(destination, &wire, Bytes);
+#else
+        for (size_t i = 0; i < Bytes; i++)
+        {
+            destination[i] = static_cast<uint8_t>(word >> (bits - 8 - 8 * i));
+        }
+#endif
+    }
+
+    // Value of Field in a packed word
+    template <typename Field>
+    static constexpr uint64_t get(uint64_t word)
+    {
+        return (word >> (bits - Field::offset - Field::width)) & Field::mask;
+    }
+
+    // Read `Bytes` big-endian bytes back into a packed word
+    static uint64_t load(const uint8_t *source)
+    {
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint64_t wire = 0;
+        memcpy(&wire, source, Bytes);
+        return __builtin_bswap64(wire) >> (64 - bits);
+#else
+        uint64_t word = 0;
+        for (size_t i = 0; i < Bytes; i++)
+        {
+            word = (word << 8) | source[i];
+        }
+        return word;
+#endif
+    }
+};
+
+// O-RAN U-plane common header and section header (section type 1, no compression header)
+struct oranHeader
+{
+    using dataDirection = bitField<0, 1>;
+    using payloadVersion = bitField<1, 3>;
+    using filterIndex = bitField<4, 4>;
+    using frameId = bitField<8, 8>;
+    using subframeId = bitField<16, 4>;
+    using slotId = bitField<20, 6>;
+    using symbolId = bitField<26, 6>;
+    using sectionId = bitField<32, 12>;
+    using rb = bitField<44, 1>;
+    using symInc = bitField<45, 1>;
+    using startPrbu = bitField<46, 10>;
+    using numPrbu = bitField<56, 8>;
+    using layout = headerLayout<8, dataDirection, payloadVersion, filterIndex, frameId, subframeId, slotId, symbolId,
+                                sectionId, rb, symInc, startPrbu, numPrbu>;
+};
+
+// O-RAN C-plane common header of a section type 1 message
+struct cplaneHeader
+{
+    using dataDirection = bitField<0, 1>;
+    using payloadVersion = bitField<1, 3>;
+    using filterIndex = bitField<4, 4>;
+    using frameId = bitField<8, 8>;
+    using subframeId = bitField<16, 4>;
+    using slotId = bitField<20, 6>;
+    using startSymbolId = bitField<26, 6>;
+    using numberOfSections = bitField<32, 8>;
+    using sectionType = bitField<40, 8>;
+    using udCompHdr = bitField<48, 8>;
+    using reserved = bitField<56, 8>;
+    using layout = headerLayout<8, dataDirection, payloadVersion, filterIndex, frameId, subframeId, slotId, startSymbolId,
+                                numberOfSections, sectionType, udCompHdr, reserved>;
+};
+
+// O-RAN C-plane section of section type 1, without section extensions
+struct cplaneSection
+{
+    using sectionId = bitField<0, 12>;
+    using rb = bitField<12, 1>;
+    using symInc = bitField<13, 1>;
+    using startPrbc = bitField<14, 10>;
+    using numPrbc = bitField<24, 8>;
+    using reMask = bitField<32, 12>;
+    using numSymbol = bitField<44, 4>;
+    using ef = bitField<48, 1>;
+    using beamId = bitField<49, 15>;
+    using layout = headerLayout<8, sectionId, rb, symInc, startPrbc, numPrbc, reMask, numSymbol, ef, beamId>;
+};
+
+// eCPRI common header followed by the IQ data (or real-time control) message fields
+struct ecpriHeader
+{
+    using revision = bitField<0, 4>;
+    using reserved = bitField<4, 3>;
+    using concatenation = bitField<7, 1>;
+    using messageType = bitField<8, 8>;
+    using payloadSize = bitField<16, 16>;
+    using pcId = bitField<32, 16>;
+    using seqId = bitField<48, 16>;
+    using layout = headerLayout<8, revision, reserved, concatenation, messageType, payloadSize, pcId, seqId>;
+};
+
+// Length field closing the MAC header (the eCPRI size takes the place of an EtherType)
+struct macLengthField
+{
+    using length = bitField<0, 16>;
+    using layout = headerLayout<2, length>;
+};
+
+// IEEE 802.1Q tag inserted between the source MAC address and the length field
+struct vlanTagField
+{
+    using tpid = bitField<0, 16>;
+    using pcp = bitField<16, 3>;
+    using dei = bitField<19, 1>;
+    using vid = bitField<20, 12>;
+    using layout = headerLayout<4, tpid, pcp, dei, vid>;
+};
+
+// VLAN tag of the frames of a flow
+struct vlanTag
+{
+    bool present{false};
+    uint16_t vlanId{0};
+    uint8_t pcp{0}; // Priority code point
+};
+
+// Header fields that change from one ORAN packet to the next
+struct packetHeaderFields
+{
+    uint8_t frameId;
+    uint8_t subframeId;
+    uint8_t slotId;
+    uint8_t symbolId;
+    uint16_t startPrbu;
+    uint16_t numPrbu;
+    uint16_t ecpriSeqid;
+    uint16_t eaxcId; // ecpriRTCid/ecpriPcid of the flow the packet belongs to
+};
+
+// Header fields of a C-plane message, which announces the sections of one slot of a flow
+struct controlHeaderFields
+{
+    uint8_t frameId;
+    uint8_t subframeId;
+    uint8_t slotId;
+    uint8_t udCompHdr;
+    uint16_t ecpriSeqid;
+    uint16_t eaxcId;
+};
+
+// Class representing an ORAN packet
+class OranPacket
+{
+private:
+    uint64_t header; // The combined ORAN packet header, packed by oranHeader::layout
+
+public:
+    static constexpr uint64_t headerSize = oranHeader::layout::size;
+
+    // Pack the header: dataDirection, payloadVersion and filterIndex are 0, sectionId is fixed to 4095
+    // (0xFFF), and numPrbu 273 (every PRB) is sent as 0
+    static constexpr uint64_t pack(uint8_t frameId, uint8_t subframeId, uint8_t slotId, uint8_t symbolId,
+                                   uint16_t startPrbu, uint16_t numPrbu)
+    {
+        return oranHeader::layout::pack(0, 0, 0, frameId, subframeId, slotId, symbolId, 0xFFF, 0, 0, startPrbu,
+                                        numPrbu == 273 ? 0 : numPrbu);
+    }
+
+    // Constructor for the ORAN packet to initialize the headers
+    OranPacket(uint8_t frameId, uint8_t subframeId, uint8_t slotId, uint8_t symbolId,
+               uint16_t startPrbu, uint16_t numPrbu)
+        : header(pack(frameId, subframeId, slotId, symbolId, startPrbu, numPrbu))
+    {
+    }
+
+    // Write the header in place, directly in front of the IQ samples
+    void writeHeader(uint8_t *destination) const
+    {
+        oranHeader::layout::store(destination, header);
+    }
+};
+
+// Class representing an eCPRI packet
+class EcpriPacket
+{
+private:
+    uint64_t header; // The eCPRI header, packed by ecpriHeader::layout
+
+public:
+    static constexpr uint64_t headerSize = ecpriHeader::layout::size;
+
+    // Pack the header: revision, reserved bits and concatenation are 0, and ecpriRTCid/ecpriPcid carries
+    // the eAxC ID of the flow
+    static constexpr uint64_t pack(uint16_t ecpriSeqid, uint16_t ecpriPayloadSize, uint16_t eaxcId = 0,
+                                   uint8_t messageType = ECPRI_IQ_DATA)
+    {
+        return ecpriHeader::layout::pack(0, 0, 0, messageType, ecpriPayloadSize, eaxcId, ecpriSeqid);
+    }
+
+    // Constructor to initialize the eCPRI packet header for a payload (ORAN packet) of the given size
+    EcpriPacket(uint16_t ecpriSeqid, uint16_t ecpriPayloadSize, uint16_t eaxcId = 0, uint8_t messageType = ECPRI_IQ_DATA)
+        : header(pack(ecpriSeqid, ecpriPayloadSize, eaxcId, messageType))
+    {
+    }
+
+    // Write the header in place, directly in front of the ORAN packet
+    void writeHeader(uint8_t *destination) const
+    {
+        ecpriHeader::layout::store(destination, header);
+    }
+};
+
+// Class representing an ORAN C-plane message of section type 1: the common header, then one section per
+// U-plane packet of a symbol
+class ControlPacket
+{
+private:
+    uint64_t header; // The common header, packed by cplaneHeader::layout
+
+public:
+    static constexpr uint64_t headerSize = cplaneHeader::layout::size;
+    static constexpr uint64_t sectionSize = cplaneSection::layout::size;
+
+    // Size of a message announcing `sections` sections
+    static constexpr uint64_t size(uint64_t sections)
+    {
+        return headerSize + sections * sectionSize;
+    }
+
+    // Pack the common header: dataDirection and filterIndex are 0 like in the U-plane, payloadVersion is 1
+    // and the sections start at symbol 0 of the slot
+    static constexpr uint64_t pack(uint8_t frameId, uint8_t subframeId, uint8_t slotId, uint8_t numberOfSections, uint8_t udCompHdr)
+    {
+        return cplaneHeader::layout::pack(0, 1, 0, frameId, subframeId, slotId, 0, numberOfSections, 1, udCompHdr, 0);
+    }
+
+    // Pack a section covering PRBs [startPrbc, startPrbc + numPrbc) on every RE of every symbol of the slot.
+    // sectionId is 4095 (0xFFF) like the U-plane sections it announces, and numPrbc 273 is sent as 0.
+    static constexpr uint64_t packSection(uint16_t startPrbc, uint16_t numPrbc)
+    {
+        return cplaneSection::layout::pack(0xFFF, 0, 0, startPrbc, numPrbc == 273 ? 0 : numPrbc, 0xFFF, SYMBOL_PER_SLOT, 0, 0);
+    }
+
+    ControlPacket(uint8_t frameId, uint8_t subframeId, uint8_t slotId, uint8_t numberOfSections, uint8_t udCompHdr)
+        : header(pack(frameId, subframeId, slotId, numberOfSections, udCompHdr))
+    {
+    }
+
+    // Write the common header followed by the sections (packed by packSection) in place
+    void write(uint8_t *destination, const vector<uint64_t> &sections) const
+    {
+        cplaneHeader::layout::store(destination, header);
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            cplaneSection::layout::store(destination + headerSize + i * sectionSize, sections[i]);
+        }
+    }
+};
+
+// Class representing an Ethernet frame encapsulating eCPRI packets
+class EthernetPacket
+{
+private:
+    // Ethernet configuration and frame components
+    uint32_t minNumOfIFGsPerPacket;                                                   // Minimum number of inter-frame gaps (IFGs)
+    const array<uint8_t, 8> preamble{0xfb, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0xd5}; // Ethernet frame preamble and SFD
+    array<uint8_t, 6> destAddress;                                                    // Destination MAC address
+    array<uint8_t, 6> sourceAddress;                                                  // Source MAC address
+    array<uint8_t, 24> frameStart;                                                    // Preamble, SFD, both MAC addresses and the VLAN tag
+    uint64_t tagSize;                                                                 // 4 with a VLAN tag, 0 otherwise
+    uint32_t addressCrc;                                                              // CRC register after both MAC addresses and the tag, the same for every frame
+
+public:
+    static constexpr uint64_t preambleSize = 8;
+    static constexpr uint64_t headerSize = 14; // Destination MAC, source MAC and EtherType/Size (untagged)
+    static constexpr uint64_t fcsSize = 4;
+
+    // Constructor to initialize the Ethernet framing shared by every frame of a flow
+    EthernetPacket(const array<uint8_t, 6> &dest, const array<uint8_t, 6> &src, const uint32_t &MinNumOfIFGsPerPacket,
+                   const vlanTag &tag = {})
+        : minNumOfIFGsPerPacket(MinNumOfIFGsPerPacket), destAddress(dest), sourceAddress(src), tagSize(tag.present ? 4 : 0)
+    {
+        memcpy(frameStart.data(), preamble.data(), preambleSize);
+        memcpy(frameStart.data() + preambleSize, destAddress.data(), destAddress.size());
+        memcpy(frameStart.data() + preambleSize + 6, sourceAddress.data(), sourceAddress.size());
+        if (tag.present)
+        {
+            vlanTagField::layout::store(frameStart.data() + preambleSize + 12, vlanTagField::layout::pack(0x8100, tag.pcp, 0, tag.vlanId));
+        }
+
+        addressCrc = crc32Engine::update(0xFFFFFFFF, frameStart.data() + preambleSize, 12 + tagSize);
+    }
+
+    // Size of the MAC header, VLAN tag included
+    uint64_t macHeaderSize() const
+    {
+        return headerSize + tagSize;
+    }
+
+    // Size of a frame carrying `payloadSize` bytes: preamble, header, payload, FCS and the IFGs that keep 4-byte alignment
+    uint64_t frameSize(uint64_t payloadSize) const
+    {
+        uint64_t size = preambleSize + macHeaderSize() + payloadSize + fcsSize + minNumOfIFGsPerPacket;
+        return (size + 3) & ~uint64_t(3);
+    }
+
+    // Write the preamble, SFD and MAC header at the start of the frame
+    void writeHeader(uint8_t *frame, uint16_t payloadSize) const
+    {
+        memcpy(frame, frameStart.data(), preambleSize + 12 + tagSize);
+        macLengthField::layout::store(frame + preambleSize + 12 + tagSize, payloadSize);
+    }
+
+    // Write the FCS and the IFGs behind a payload that is already in place. If the last `knownTailLength`
+    // payload bytes have a known CRC (`knownTailCrc`), only the bytes in front of them are scanned;
+    // `knownTailShift` is crc32Engine::shiftFactor(knownTailLength). Returns the full frame size.
+    uint64_t writeTrailer(uint8_t *frame, uint64_t payloadSize, uint64_t knownTailLength = 0, uint32_t knownTailCrc = 0,
+                          uint32_t knownTailShift = 0) const
+    {
+        const uint8_t *crcStart = frame + preambleSize + 12 + tagSize; // Addresses and tag are already accounted for in addressCrc
+        uint32_t crc = crc32Engine::update(addressCrc, crcStart, 2 + payloadSize - knownTailLength) ^ 0xFFFFFFFF;
+        if (knownTailLength > 0)
+        {
+            crc = crc32Engine::combineWithFactor(crc, knownTailCrc, knownTailShift);
+        }
+
+        // Frame Check Sequence, most significant byte first
+        uint8_t *fcs = frame + preambleSize + macHeaderSize() + payloadSize;
+        fcs[0] = static_cast<uint8_t>(crc >> 24);
+        fcs[1] = static_cast<uint8_t>(crc >> 16);
+        fcs[2] = static_cast<uint8_t>(crc >> 8);
+        fcs[3] = static_cast<uint8_t>(crc);
+
+        // Minimum number of IFGs plus the IFGs that keep the frame 4-byte aligned
+        uint64_t used = preambleSize + macHeaderSize() + payloadSize + fcsSize;
+        uint64_t size = frameSize(payloadSize);
+        memset(frame + used, 0x07, size - used);
+
+        return size;
+    }
+};
+
+// Builds complete frames inside a single buffer. The headroom for every header is reserved once in front
+// of the IQ samples: the samples are copied straight into their final position, then each layer writes
+// its header in place (ORAN, eCPRI, Ethernet) and the FCS and IFGs are appended behind them.
+class frameBuilder
+{
+private:
+    EthernetPacket ethernet;
+    uint64_t nominalIqBytes; // IQ bytes carried by a regular packet of the stream
+    uint32_t nominalIqShift; // crc32Engine::shiftFactor(nominalIqBytes), needed to combine a known IQ CRC
+    uint64_t headroom;       // Bytes in front of the IQ samples (preamble, MAC header, eCPRI and ORAN headers)
+
+public:
+    frameBuilder(const array<uint8_t, 6> &dest, const array<uint8_t, 6> &src, uint32_t minNumOfIFGsPerPacket, uint64_t iqBytesPerPacket,
+                 const vlanTag &tag = {})
+        : ethernet(dest, src, minNumOfIFGsPerPacket, tag), nominalIqBytes(iqBytesPerPacket),
+          nominalIqShift(crc32Engine::shiftFactor(iqBytesPerPacket)),
+          headroom(EthernetPacket::preambleSize + ethernet.macHeaderSize() + EcpriPacket::headerSize + OranPacket::headerSize)
+    {
+    }
+
+    // Size in the stream of a frame carrying `iqBytes` bytes of IQ samples (IFGs included)
+    uint64_t frameSize(uint64_t iqBytes) const
+    {
+        return ethernet.frameSize(EcpriPacket::headerSize + OranPacket::headerSize + iqBytes);
+    }
+
+    // Where the IQ samples of a frame starting at `frame` have to be placed
+    uint8_t *iqPosition(uint8_t *frame) const
+    {
+        return frame + headroom;
+    }
+
+    // Stamp every header around the IQ samples already placed at iqPosition(frame) and append FCS and IFGs.
+    // `iqCrc` is the CRC-32 of the IQ samples when it is already known (nullptr otherwise).
+    // Returns the frame size.
+    uint64_t finishFrame(uint8_t *frame, const packetHeaderFields &fields, uint64_t iqBytes, const uint32_t *iqCrc = nullptr) const
+    {
+        uint8_t *ecpri = frame + EthernetPacket::preambleSize + ethernet.macHeaderSize();
+        uint8_t *oran = ecpri + EcpriPacket::headerSize;
+        uint16_t oranSize = static_cast<uint16_t>(OranPacket::headerSize + iqBytes);
+        uint16_t ecpriSize = static_cast<uint16_t>(EcpriPacket::headerSize + oranSize);
+
+        {
+            scopedStage timer{stage::headerPacking};
+            OranPacket{fields.frameId, fields.subframeId, fields.slotId, fields.symbolId, fields.startPrbu, fields.numPrbu}.writeHeader(oran);
+            EcpriPacket{fields.ecpriSeqid, oranSize, fields.eaxcId}.writeHeader(ecpri);
+            ethernet.writeHeader(frame, ecpriSize);
+        }
+
+        scopedStage timer{stage::crc, ecpriSize};
+        if (iqCrc)
+        {
+            uint32_t shift = iqBytes == nominalIqBytes ? nominalIqShift : crc32Engine::shiftFactor(iqBytes);
+            return ethernet.writeTrailer(frame, ecpriSize, iqBytes, *iqCrc, shift);
+        }
+        return ethernet.writeTrailer(frame, ecpriSize);
+    }
+
+    // Size in the stream of a frame carrying a C-plane message of `sections` sections (IFGs included)
+    uint64_t controlFrameSize(uint64_t sections) const
+    {
+        return ethernet.frameSize(EcpriPacket::headerSize + ControlPacket::size(sections));
+    }
+
+    // Build a C-plane message announcing `sections` (packed by ControlPacket::packSection) in the frame
+    // starting at `frame`, with its eCPRI and Ethernet headers, FCS and IFGs. Returns the frame size.
+    uint64_t finishControlFrame(uint8_t *frame, const controlHeaderFields &fields, const vector<uint64_t> &sections) const
+    {
+        uint8_t *ecpri = frame + EthernetPacket::preambleSize + ethernet.macHeaderSize();
+        uint16_t controlSize = static_cast<uint16_t>(ControlPacket::size(sections.size()));
+        uint16_t ecpriSize = static_cast<uint16_t>(EcpriPacket::headerSize + controlSize);
+
+        {
+            scopedStage timer{stage::headerPacking};
+            ControlPacket{fields.frameId, fields.subframeId, fields.slotId, static_cast<uint8_t>(sections.size()), fields.udCompHdr}
+                .write(ecpri + EcpriPacket::headerSize, sections);
+            EcpriPacket{fields.ecpriSeqid, controlSize, fields.eaxcId, ECPRI_RT_CONTROL}.writeHeader(ecpri);
+            ethernet.writeHeader(frame, ecpriSize);
+        }
+
+        scopedStage timer{stage::crc, ecpriSize};
+        return ethernet.writeTrailer(frame, ecpriSize);
+    }
+};
+
+// Formats bytes in the packets.txt layout: 2 lowercase hex digits per byte, a line break after every 4 bytes.
+// Whole lines are formatted 16 bytes at a time with an SSSE3 nibble shuffle when the CPU supports it,
+// otherwise through a 256-entry table of digit pairs.
+class hexEncoder
+{
+public:
+    // Number of characters produced for `length` bytes when `counter` bytes are already on the current line
+    static uint64_t encodedSize(uint64_t length, uint8_t counter)
+    {
+        return 2 * length + (counter + length) / 4;
+    }
+
+    // Format `length` bytes into `out` and return the end of the written characters. `counter` holds the
+    // number of bytes already on the current line and is updated, so a stream can be encoded in pieces.
+    static char *encode(const uint8_t *data, uint64_t length, uint8_t &counter, char *out)
+    {
+        // Finish the current line byte by byte
+        while (length > 0 && counter != 0)
+        {
+            out = encodeByte(*data++, counter, out);
+            length--;
+        }
+
+        // Whole lines
+        uint64_t lines = length / 4;
+        out = kernel()(data, lines, out);
+        data += lines * 4;
+        length -= lines * 4;
+
+        // Start of a last, partial line
+        while (length-- > 0)
+        {
+            out = encodeByte(*data++, counter, out);
+        }
+        return out;
+    }
+
+private:
+    static const array<uint16_t, 256> &digitPairs()
+    {
+        static const array<uint16_t, 256> table = []
+        {
+            const char *digits = "0123456789abcdef";
+            array<uint16_t, 256> result{};
+            for (int i = 0; i < 256; i++)
+            {
+                char pair[2] = {digits[i >> 4], digits[i & 0x0F]};
+                memcpy(&result[i], pair, 2);
+            }
+            return result;
+        }();
+        return table;
+    }
+
+    static char *encodeByte(uint8_t byte, uint8_t &counter, char *out)
+    {
+        memcpy(out, &digitPairs()[byte], 2);
+        out += 2;
+        if (++counter == 4)
+        {
+            *out++ = '\n';
+            counter = 0;
+        }
+        return out;
+    }
+
+    // Format `lines` groups of 4 bytes, each followed by a line break
+    static char *encodeLinesTable(const uint8_t *data, uint64_t lines, char *out)
+    {
+        const auto &pairs = digitPairs();
+        for (uint64_t i = 0; i < lines; i++, data += 4, out += 9)
+        {
+            memcpy(out + 0, &pairs[data[0]], 2);
+            memcpy(out + 2, &pairs[data[1]], 2);
+            memcpy(out + 4, &pairs[data[2]], 2);
+            memcpy(out + 6, &pairs[data[3]], 2);
+            out[8] = '\n';
+        }
+        return out;
+    }
+
+#ifdef HAVE_X86_INTRINSICS
+    // 16 bytes (4 lines) per iteration: split the nibbles, map them to digits with one shuffle each,
+    // interleave them and store the 8-character lines with their line breaks
+    __attribute__((target("ssse3"))) static char *encodeLinesSsse3(const uint8_t *data, uint64_t lines, char *out)
+    {
+        const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+        const __m128i lowNibble = _mm_set1_epi8(0x0F);
+
+        for (; lines >= 4; lines -= 4, data += 16, out += 36)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+            __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), lowNibble));
+            __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, lowNibble));
+            __m128i first = _mm_unpacklo_epi8(high, low);  // Characters of bytes 0-7
+            __m128i second = _mm_unpackhi_epi8(high, low); // Characters of bytes 8-15
+
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 0), first);
+            out[8] = '\n';
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 9), _mm_srli_si128(first, 8));
+            out[17] = '\n';
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 18), second);
+            out[26] = '\n';
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 27), _mm_srli_si128(second, 8));
+            out[35] = '\n';
+        }
+        return encodeLinesTable(data, lines, out);
+    }
+#endif
+
+    // Pick the line kernel supported by the running CPU
+    static char *(*kernel())(const uint8_t *, uint64_t, char *)
+    {
+        static char *(*const selected)(const uint8_t *, uint64_t, char *) = []
+        {
+#ifdef HAVE_X86_INTRINSICS
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("ssse3"))
+            {
+                return encodeLinesSsse3;
+            }
+#endif
+            return encodeLinesTable;
+        }();
+        return selected;
+    }
+};
+
+// Reads the packets.txt layout back into bytes. Whole lines are decoded 4 at a time with SSSE3 shuffles
+// when the CPU supports it, otherwise through a table of digit values. Text that does not follow the
+// layout exactly (other line breaks, blank lines) is handled by decodeLoose, which skips whitespace.
+class hexDecoder
+{
+public:
+    static constexpr uint64_t lineChars = 9; // 8 digits and a line break
+
+    // Bytes held by `chars` characters of the packets.txt layout
+    static uint64_t decodedSize(uint64_t chars)
+    {
+        return 4 * (chars / lineChars) + (chars % lineChars) / 2;
+    }
+
+    // Decode `chars` characters of the packets.txt layout starting at a line. Returns false when the text
+    // does not follow the layout.
+    static bool decode(const char *text, uint64_t chars, uint8_t *out)
+    {
+        uint64_t lines = chars / lineChars;
+        if (!kernel()(text, lines, out))
+        {
+            return false;
+        }
+
+        // Last, partial line without a line break
+        uint64_t rest = chars % lineChars;
+        if (rest % 2 != 0)
+        {
+            return false;
+        }
+        return decodeDigits(text + lines * lineChars, rest / 2, out + 4 * lines);
+    }
+
+    // Decode pairs of hex digits separated by any whitespace. Returns the number of bytes written.
+    static uint64_t decodeLoose(const char *text, uint64_t chars, uint8_t *out)
+    {
+        const auto &values = digitValues();
+        uint8_t *start = out;
+        for (uint64_t i = 0; i < chars;)
+        {
+            if (isspace(static_cast<unsigned char>(text[i])))
+            {
+                i++;
+                continue;
+            }
+            uint8_t high = values[static_cast<uint8_t>(text[i])];
+            uint8_t low = i + 1 < chars ? values[static_cast<uint8_t>(text[i + 1])] : 0xFF;
+            if ((high | low) > 0x0F)
+            {
+                throw runtime_error("Malformed hex capture at character " + to_string(i));
+            }
+            *out++ = static_cast<uint8_t>((high << 4) | low);
+            i += 2;
+        }
+        return out - start;
+    }
+
+private:
+    // Value of every hex digit, 0xFF for other characters
+    static const array<uint8_t, 256> &digitValues()
+    {
+        static const array<uint8_t, 256> table = []
+        {
+            array<uint8_t, 256> result;
+            result.fill(0xFF);
+            for (int i = 0; i < 10; i++)
+            {
+                result['0' + i] = static_cast<uint8_t>(i);
+            }
+            for (int i = 0; i < 6; i++)
+            {
+                result['a' + i] = result['A' + i] = static_cast<uint8_t>(10 + i);
+            }
+            return result;
+        }();
+        return table;
+    }
+
+    static bool decodeDigits(const char *text, uint64_t bytes, uint8_t *out)
+    {
+        const auto &values = digitValues();
+        uint8_t invalid = 0;
+        for (uint64_t i = 0; i < bytes; i++)
+        {
+            uint8_t high = values[static_cast<uint8_t>(text[2 * i])];
+            uint8_t low = values[static_cast<uint8_t>(text[2 * i + 1])];
+            invalid |= high | low;
+            out[i] = static_cast<uint8_t>((high << 4) | low);
+        }
+        return invalid <= 0x0F;
+    }
+
+    // Decode `lines` lines of 8 digits followed by a line break
+    static bool decodeLinesTable(const char *text, uint64_t lines, uint8_t *out)
+    {
+        for (uint64_t i = 0; i < lines; i++, text += lineChars, out += 4)
+        {
+            if (text[8] != '\n' || !decodeDigits(text, 4, out))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+#ifdef HAVE_X86_INTRINSICS
+    // Values of 16 hex digits; false if one of them is not a digit
+    __attribute__((target("ssse3"))) static bool digitsSsse3(__m128i characters, __m128i &values)
+    {
+        __m128i digit = _mm_sub_epi8(characters, _mm_set1_epi8('0'));
+        __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(digit, _mm_set1_epi8(-1)), _mm_cmplt_epi8(digit, _mm_set1_epi8(10)));
+        __m128i letter = _mm_sub_epi8(_mm_or_si128(characters, _mm_set1_epi8(0x20)), _mm_set1_epi8('a' - 10));
+        __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(letter, _mm_set1_epi8(9)), _mm_cmplt_epi8(letter, _mm_set1_epi8(16)));
+        values = _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, letter));
+        return _mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) == 0xFFFF;
+    }
+
+    // 4 lines (36 characters, 16 bytes) per iteration: gather the 32 digits with shuffles that drop the
+    // line breaks, turn them into nibbles and merge each pair into a byte with a multiply-add
+    __attribute__((target("ssse3"))) static bool decodeLinesSsse3(const char *text, uint64_t lines, uint8_t *out)
+    {
+        const __m128i firstLow = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 13, 14, 15, -128);
+        const __m128i firstHigh = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0);
+        const __m128i secondLow = _mm_setr_epi8(2, 3, 4, 5, 6, 7, 8, 9, 11, 12, 13, 14, 15, -128, -128, -128);
+        const __m128i secondHigh = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 12, 13, 14);
+        const __m128i weights = _mm_set1_epi16(0x0110); // 16 for the high digit, 1 for the low digit
+
+        for (; lines >= 4; lines -= 4, text += 4 * lineChars, out += 16)
+        {
+            if (text[8] != '\n' || text[17] != '\n' || text[26] != '\n' || text[35] != '\n')
+            {
+                return false;
+            }
+            __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text));      // Characters 0-15
+            __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + 16)); // Characters 16-31
+            __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + 20)); // Characters 20-35
+            __m128i first, second;
+            if (!digitsSsse3(_mm_or_si128(_mm_shuffle_epi8(v0, firstLow), _mm_shuffle_epi8(v1, firstHigh)), first) ||
+                !digitsSsse3(_mm_or_si128(_mm_shuffle_epi8(v1, secondLow), _mm_shuffle_epi8(v2, secondHigh)), second))
+            {
+                return false;
+            }
+            __m128i bytes = _mm_packus_epi16(_mm_maddubs_epi16(first, weights), _mm_maddubs_epi16(second, weights));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), bytes);
+        }
+        return decodeLinesTable(text, lines, out);
+    }
+#endif
+
+    // Pick the line kernel supported by the running CPU
+    static bool (*kernel())(const char *, uint64_t, uint8_t *)
+    {
+        static bool (*const selected)(const char *, uint64_t, uint8_t *) = []
+        {
+#ifdef HAVE_X86_INTRINSICS
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("ssse3"))
+            {
+                return decodeLinesSsse3;
+            }
+#endif
+            return decodeLinesTable;
+        }();
+        return selected;
+    }
+};
+
+// Write bytes as 2-digit hex values with a line break after every 4 bytes (the packets.txt layout).
+// `counter` holds the number of bytes already on the current line, so a stream can be written in pieces.
+// The text is formatted in large blocks and written with a few large write calls.
+void writeHexLines(ostream &file, const uint8_t *data, uint64_t length, uint8_t &counter)
+{
+    static thread_local vector<char> text; // Kept from one call (and one run) to the next
+    text.resize(max<uint64_t>(text.size(), hexEncoder::encodedSize(min<uint64_t>(length, HEX_EXPORT_BLOCK), 3)));
+    while (length > 0)
+    {
+        uint64_t block = min<uint64_t>(length, HEX_EXPORT_BLOCK);
+        char *end = hexEncoder::encode(data, block, counter, text.data());
+        file.write(text.data(), end - text.data());
+        data += block;
+        length -= block;
+    }
+}
+
+#ifndef _WIN32
+// Write all `length` bytes at `offset` of the open file `fd`, retrying partial writes
+bool pwriteAll(int fd, const char *data, uint64_t length, uint64_t offset)
+{
+    while (length > 0)
+    {
+        ssize_t written = pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        offset += written;
+        length -= written;
+    }
+    return true;
+}
+
+// Reserve the final size of an output file up front so that positional writes land in allocated blocks
+void preallocateFile(int fd, uint64_t size)
+{
+#ifdef __linux__
+    if (fallocate(fd, 0, 0, static_cast<off_t>(size)) == 0)
+    {
+        return;
+    }
+#endif
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        throw runtime_error("Failed to size the output file");
+    }
+}
+
+// Format the bytes found at `streamOffset` of the stream in the packets.txt layout and write them at their
+// place in the open file `fd`. Every 4 stream bytes become exactly 9 characters, so the file offset of any
+// byte is known in advance: the bytes are split into `threads` slices of whole lines, and each thread
+// formats its slice block by block and writes each block with pwrite at its final offset.
+void pwriteHexAt(int fd, const uint8_t *data, uint64_t length, uint64_t streamOffset, unsigned threads)
+{
+    uint64_t end = streamOffset + length;
+    uint64_t linesPerSlice = ((length + 3) / 4 + threads - 1) / threads;
+    atomic<bool> failed{false};
+
+    auto exportSlice = [&](uint64_t sliceBegin, uint64_t sliceEnd)
+    {
+        vector<char> text(hexEncoder::encodedSize(HEX_EXPORT_BLOCK, 3));
+        for (uint64_t block = sliceBegin; block < sliceEnd && !failed; block += HEX_EXPORT_BLOCK)
+        {
+            uint64_t blockLength = min<uint64_t>(HEX_EXPORT_BLOCK, sliceEnd - block);
+            uint8_t counter = block % 4; // Bytes already on the line this block starts in
+            char *stop = hexEncoder::encode(data + (block - streamOffset), blockLength, counter, text.data());
+            if (!pwriteAll(fd, text.data(), stop - text.data(), hexEncoder::encodedSize(block, 0)))
+            {
+                failed = true;
+            }
+        }
+    };
+
+    // Slices start on line boundaries of the stream, except the first one
+    vector<thread> workers;
+    uint64_t sliceBegin = streamOffset;
+    while (sliceBegin < end)
+    {
+        uint64_t sliceEnd = min(end, (sliceBegin / 4 + linesPerSlice) * 4);
+        workers.emplace_back(exportSlice, sliceBegin, sliceEnd);
+        sliceBegin = sliceEnd;
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    if (failed)
+    {
+        throw runtime_error("Failed to write the output file");
+    }
+}
+#endif
+
+// Splits a raw stream back into Ethernet frames. IFG bytes (0x07) between frames are skipped, the 8-byte
+// preamble and SFD are checked and dropped, and the frame length (MAC header, payload and FCS) is taken
+// from the length field of the MAC header. The stream may be fed in pieces of any size.
+class streamDeframer
+{
+public:
+    using frameHandler = function<void(const uint8_t *frame, uint64_t length, uint64_t streamOffset)>;
+
+private:
+    static constexpr uint64_t preambleSize = 8;
+    static constexpr uint64_t headerSize = 14;
+    static constexpr uint64_t fcsSize = 4;
+
+    frameHandler handler;
+    vector<uint8_t> frame;    // Bytes of the current frame, preamble excluded
+    uint64_t position{0};     // Stream offset of the next byte fed in
+    uint64_t frameStart{0};   // Stream offset of the preamble of the current frame
+    uint64_t preambleLeft{0}; // Preamble bytes of the current frame still to skip
+    uint64_t frameLength{0};  // Size of the current frame once its header is complete (0 = not known yet)
+    uint64_t headerLength{0}; // Size of the MAC header of the current frame, VLAN tag included
+    bool inFrame{false};
+
+public:
+    streamDeframer(frameHandler Handler) : handler(move(Handler))
+    {
+    }
+
+    void feed(const uint8_t *data, uint64_t length)
+    {
+        const uint8_t *end = data + length;
+        while (data < end)
+        {
+            if (!inFrame)
+            {
+                // Skip the IFGs up to the next preamble
+                const uint8_t *start = data;
+                while (data < end && *data == 0x07)
+                {
+                    data++;
+                }
+                position += data - start;
+                if (data == end)
+                {
+                    break;
+                }
+                inFrame = true;
+                frameStart = position;
+                preambleLeft = preambleSize;
+                frameLength = 0;
+                headerLength = headerSize;
+                frame.clear();
+            }
+
+            if (preambleLeft > 0)
+            {
+                uint64_t take = min<uint64_t>(preambleLeft, end - data);
+                preambleLeft -= take;
+                data += take;
+                position += take;
+                if (preambleLeft == 0 && data[-1] != 0xd5)
+                {
+                    throw runtime_error("Malformed stream: missing start frame delimiter at byte " + to_string(position - 1));
+                }
+                continue;
+            }
+
+            uint64_t wanted = frameLength ? frameLength : headerLength;
+            uint64_t take = min<uint64_t>(wanted - frame.size(), end - data);
+            frame.insert(frame.end(), data, data + take);
+            data += take;
+            position += take;
+            if (frame.size() < wanted)
+            {
+                continue;
+            }
+
+            if (frameLength == 0)
+            {
+                // A VLAN tag moves the length field 4 bytes further
+                if (headerLength == headerSize && frame[12] == 0x81 && frame[13] == 0x00)
+                {
+                    headerLength += 4;
+                    continue;
+                }
+
+                // The header is complete: the length field gives the payload size
+                frameLength = headerLength + ((uint64_t(frame[headerLength - 2]) << 8) | frame[headerLength - 1]) + fcsSize;
+                continue;
+            }
+
+            handler(frame.data(), frame.size(), frameStart);
+            inFrame = false;
+        }
+    }
+
+    // Skip `length` IFG bytes without reading them; only valid between frames
+    void skipIdle(uint64_t length)
+    {
+        if (inFrame)
+        {
+            throw runtime_error("Malformed stream: IFGs inside the frame at byte " + to_string(frameStart));
+        }
+        position += length;
+    }
+
+    // True when the stream ended between frames
+    bool idle() const { return !inFrame; }
+};
+
+// Writes Ethernet frames to a pcapng capture (one section, one Ethernet interface with nanosecond
+// timestamps). Frames keep their FCS, which the interface advertises through if_fcslen. Blocks are
+// collected in a buffer and written PCAPNG_WRITE_BLOCK bytes at a time.
+class pcapngWriter
+{
+private:
+    ofstream file;
+    vector<uint8_t> buffer;
+    uint64_t frames{0};
+
+    void put32(uint32_t value)
+    {
+        uint8_t bytes[4];
+        memcpy(bytes, &value, 4); // pcapng is written in host byte order, the byte-order magic tells readers which
+        buffer.insert(buffer.end(), bytes, bytes + 4);
+    }
+
+    void put16(uint16_t value)
+    {
+        uint8_t bytes[2];
+        memcpy(bytes, &value, 2);
+        buffer.insert(buffer.end(), bytes, bytes + 2);
+    }
+
+    void flush()
+    {
+        file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<streamsize>(buffer.size()));
+        buffer.clear();
+    }
+
+public:
+    pcapngWriter(const string &fileName) : file(fileName, ios::out | ios::binary)
+    {
+        if (!file)
+        {
+            throw runtime_error("Failed to open output file " + fileName);
+        }
+        buffer.reserve(PCAPNG_WRITE_BLOCK + 65536);
+
+        // Section Header Block: byte-order magic, version 1.0, unknown section length
+        put32(0x0A0D0D0A);
+        put32(28);
+        put32(0x1A2B3C4D);
+        put16(1);
+        put16(0);
+        put32(0xFFFFFFFF);
+        put32(0xFFFFFFFF);
+        put32(28);
+
+        // Interface Description Block: Ethernet, no snap length, if_tsresol = 9 (ns), if_fcslen = 4
+        put32(0x00000001);
+        put32(40);
+        put16(1);
+        put16(0);
+        put32(0);
+        put16(9);
+        put16(1);
+        put32(9);
+        put16(13);
+        put16(1);
+        put32(4);
+        put32(0);
+        put32(40);
+    }
+
+    ~pcapngWriter()
+    {
+        close();
+    }
+
+    // Append one frame (MAC header through FCS) captured at `timestampNs`
+    void writeFrame(const uint8_t *frame, uint64_t length, uint64_t timestampNs)
+    {
+        uint32_t padded = static_cast<uint32_t>((length + 3) & ~uint64_t(3));
+        uint32_t blockLength = 32 + padded;
+
+        // Enhanced Packet Block on interface 0
+        put32(0x00000006);
+        put32(blockLength);
+        put32(0);
+        put32(static_cast<uint32_t>(timestampNs >> 32));
+        put32(static_cast<uint32_t>(timestampNs));
+        put32(static_cast<uint32_t>(length));
+        put32(static_cast<uint32_t>(length));
+        buffer.insert(buffer.end(), frame, frame + length);
+        buffer.insert(buffer.end(), padded - length, 0);
+        put32(blockLength);
+        frames++;
+
+        if (buffer.size() >= PCAPNG_WRITE_BLOCK)
+        {
+            flush();
+        }
+    }
+
+    void close()
+    {
+        if (file.is_open())
+        {
+            flush();
+            file.close();
+        }
+    }
+
+    uint64_t getFrames() const { return frames; }
+};
+
+// Compact container of a stream: frames are stored verbatim and IFG runs by their length only. A 24-byte
+// header (magic "ORANRLE1", then the stream size in bytes and the line rate in Gbps, little-endian) is
+// followed by records, each starting with the LEB128 varint (length << 1 | idle). An idle record stands for
+// `length` IFG bytes (0x07); any other record is followed by its `length` bytes. IFG runs shorter than
+// RLE_MIN_IDLE_RUN bytes stay in the literal bytes, where they cost less than a record.
+class rleEncoder
+{
+public:
+    static constexpr char magic[8] = {'O', 'R', 'A', 'N', 'R', 'L', 'E', '1'};
+    static constexpr uint64_t headerSize = 24;
+
+private:
+    ofstream file;
+    vector<uint8_t> buffer;  // Records waiting to be written
+    vector<uint8_t> literal; // Bytes of the literal record in progress
+    uint64_t idleRun{0};     // IFG bytes of the run in progress
+    uint64_t encodedBytes{headerSize};
+
+    void put64(uint64_t value)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void putVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            buffer.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    void flushLiteral()
+    {
+        if (!literal.empty())
+        {
+            putVarint(literal.size() << 1);
+            buffer.insert(buffer.end(), literal.begin(), literal.end());
+            literal.clear();
+        }
+    }
+
+    void endIdleRun()
+    {
+        if (idleRun >= RLE_MIN_IDLE_RUN)
+        {
+            flushLiteral();
+            putVarint(idleRun << 1 | 1);
+        }
+        else
+        {
+            literal.insert(literal.end(), idleRun, 0x07);
+        }
+        idleRun = 0;
+    }
+
+    void flush()
+    {
+        file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<streamsize>(buffer.size()));
+        encodedBytes += buffer.size();
+        buffer.clear();
+    }
+
+public:
+    rleEncoder(const string &fileName, uint64_t streamBytes, uint64_t lineRate) : file(fileName, ios::out | ios::binary)
+    {
+        if (!file)
+        {
+            throw runtime_error("Failed to open output file " + fileName);
+        }
+        buffer.reserve(RLE_WRITE_BLOCK + 16);
+        file.write(magic, sizeof(magic));
+        put64(streamBytes);
+        put64(lineRate);
+        file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<streamsize>(buffer.size()));
+        buffer.clear();
+    }
+
+    ~rleEncoder()
+    {
+        close();
+    }
+
+    // Encode the next `length` bytes of the stream; runs and records may span calls
+    void feed(const uint8_t *data, uint64_t length)
+    {
+        const uint8_t *end = data + length;
+        while (data < end)
+        {
+            if (*data == 0x07)
+            {
+                // Long idle runs are skipped eight bytes at a time
+                const uint8_t *start = data;
+                uint64_t word;
+                while (end - data >= 8 && (memcpy(&word, data, 8), word == 0x0707070707070707ULL))
+                {
+                    data += 8;
+                }
+                while (data < end && *data == 0x07)
+                {
+                    data++;
+                }
+                idleRun += data - start;
+                continue;
+            }
+            if (idleRun > 0)
+            {
+                endIdleRun();
+            }
+            const uint8_t *next = static_cast<const uint8_t *>(memchr(data, 0x07, end - data));
+            next = next ? next : end;
+            literal.insert(literal.end(), data, next);
+            data = next;
+            if (literal.size() >= RLE_WRITE_BLOCK)
+            {
+                flushLiteral();
+            }
+            if (buffer.size() >= RLE_WRITE_BLOCK)
+            {
+                flush();
+            }
+        }
+    }
+
+    // Encode the next `length` bytes of the stream, all of them IFG bytes
+    void feedIdle(uint64_t length)
+    {
+        idleRun += length;
+    }
+
+    void close()
+    {
+        if (file.is_open())
+        {
+            if (idleRun > 0)
+            {
+                endIdleRun();
+            }
+            flushLiteral();
+            flush();
+            file.close();
+        }
+    }
+
+    // Size of the container so far, header included
+    uint64_t getEncodedBytes() const { return encodedBytes + buffer.size(); }
+};
+
+// Destination of a generated stream. The generator pushes the stream in order through write(), one
+// chunk at a time, so the memory it needs does not depend on the capture length.
+class streamSink
+{
+public:
+    virtual ~streamSink() = default;
+
+    // Called once before the first chunk with the final size of the stream
+    virtual void begin(uint64_t totalBytes)
+    {
+        (void)totalBytes;
+    }
+
+    // Consume the next `length` bytes of the stream
+    virtual void write(const uint8_t *data, uint64_t length) = 0;
+
+    // Consume the next `length` bytes of the stream, all of them IFG bytes (0x07). Sinks that do not need
+    // the bytes themselves override this to skip materializing them.
+    virtual void writeIdle(uint64_t length)
+    {
+        static const vector<uint8_t> idle(STREAM_CHUNK_SIZE, 0x07);
+        while (length > 0)
+        {
+            uint64_t run = min<uint64_t>(length, idle.size());
+            write(idle.data(), run);
+            length -= run;
+        }
+    }
+
+    // Memory holding the whole stream that the generator may fill directly, in which case write() is not
+    // called. Only valid between begin() and end(); nullptr when the sink has no such memory.
+    virtual uint8_t *directWindow()
+    {
+        return nullptr;
+    }
+
+    // Called once after the last chunk
+    virtual void end()
+    {
+    }
+};
+
+// Keeps the whole stream in memory (the behavior of the original generator)
+class memorySink : public streamSink
+{
+private:
+    vector<uint8_t> stream;
+    uint64_t position{0}; // Bytes received through write()
+
+public:
+    void begin(uint64_t totalBytes) override
+    {
+        stream.assign(totalBytes, 0);
+        position = 0;
+    }
+
+    void write(const uint8_t *data, uint64_t length) override
+    {
+        memcpy(stream.data() + position, data, length);
+        position += length;
+    }
+
+    uint8_t *directWindow() override
+    {
+        return stream.data();
+    }
+
+    vector<uint8_t> &getStream() { return stream; }
+};
+
+// Writes the stream to a file, either in the packets.txt hex layout or as raw bytes. With several export
+// threads the hex text of every chunk is formatted in parallel and written at its final offset.
+class fileSink : public streamSink
+{
+private:
+    string fileName;
+    bool binary;
+    unsigned exportThreads;
+    ofstream file;
+    uint8_t counter{0}; // Bytes already written on the current hex line
+    int fd{-1};         // File descriptor used for positional writes
+    uint64_t position{0};
+
+public:
+    fileSink(const string &FileName, bool Binary = false, unsigned ExportThreads = 1)
+        : fileName(FileName), binary(Binary), exportThreads(ExportThreads)
+    {
+    }
+
+    void begin(uint64_t totalBytes) override
+    {
+        counter = 0;
+        position = 0;
+        console() << " Streaming the stream to .\\" << fileName << (binary ? " (binary)" : " (hex)") << endl;
+#ifndef _WIN32
+        if (!binary && exportThreads > 1)
+        {
+            fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+            {
+                throw runtime_error("Failed to open output file " + fileName);
+            }
+            preallocateFile(fd, hexEncoder::encodedSize(totalBytes, 0));
+            return;
+        }
+#else
+        (void)totalBytes;
+#endif
+        file.open(fileName, binary ? ios::out | ios::binary : ios::out);
+        if (!file)
+        {
+            throw runtime_error("Failed to open output file " + fileName);
+        }
+    }
+
+    void write(const uint8_t *data, uint64_t length) override
+    {
+#ifndef _WIN32
+        if (fd >= 0)
+        {
+            pwriteHexAt(fd, data, length, position, exportThreads);
+            position += length;
+            return;
+        }
+#endif
+        if (binary)
+        {
+            file.write(reinterpret_cast<const char *>(data), static_cast<streamsize>(length));
+        }
+        else
+        {
+            writeHexLines(file, data, length, counter);
+        }
+        if (!file)
+        {
+            throw runtime_error("Failed to write the output file");
+        }
+    }
+
+    void end() override
+    {
+#ifndef _WIN32
+        if (fd >= 0)
+        {
+            int result = close(fd);
+            fd = -1;
+            if (result != 0)
+            {
+                throw runtime_error("Failed to write the output file");
+            }
+            return;
+        }
+#endif
+        file.close();
+        if (!file)
+        {
+            throw runtime_error("Failed to write the output file");
+        }
+    }
+};
+
+#ifndef _WIN32
+// Maps the output file into memory. The final size of the file is known before generation starts, so it
+// is sized with ftruncate and mapped up front. Binary frames are then built straight into the mapping and
+// hex text is formatted straight into it; the kernel writes the pages back in the background.
+class mmapSink : public streamSink
+{
+private:
+    string fileName;
+    bool binary;
+    int fd{-1};
+    uint8_t *mapping{nullptr};
+    uint64_t mappedBytes{0};
+    uint64_t position{0}; // Stream bytes received through write()
+
+public:
+    mmapSink(const string &FileName, bool Binary = false) : fileName(FileName), binary(Binary)
+    {
+    }
+
+    ~mmapSink()
+    {
+        end();
+    }
+
+    void begin(uint64_t totalBytes) override
+    {
+        position = 0;
+        mappedBytes = binary ? totalBytes : hexEncoder::encodedSize(totalBytes, 0);
+
+        fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            throw runtime_error("Failed to open output file " + fileName);
+        }
+        if (ftruncate(fd, static_cast<off_t>(mappedBytes)) != 0)
+        {
+            throw runtime_error("Failed to size the output file " + fileName);
+        }
+        if (mappedBytes > 0)
+        {
+            void *address = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (address == MAP_FAILED)
+            {
+                throw runtime_error("Failed to map the output file " + fileName);
+            }
+            mapping = static_cast<uint8_t *>(address);
+            madvise(mapping, mappedBytes, MADV_SEQUENTIAL);
+        }
+        console() << " Mapping the stream to .\\" << fileName << (binary ? " (binary)" : " (hex)") << endl;
+    }
+
+    void write(const uint8_t *data, uint64_t length) override
+    {
+        if (binary)
+        {
+            memcpy(mapping + position, data, length);
+        }
+        else
+        {
+            uint8_t counter = position % 4; // Bytes already on the line this piece starts in
+            hexEncoder::encode(data, length, counter, reinterpret_cast<char *>(mapping) + hexEncoder::encodedSize(position, 0));
+        }
+        position += length;
+    }
+
+    uint8_t *directWindow() override
+    {
+        return binary ? mapping : nullptr;
+    }
+
+    void end() override
+    {
+        if (mapping)
+        {
+            munmap(mapping, mappedBytes);
+            mapping = nullptr;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+};
+#endif
+
+// Discards the stream, useful to measure generation alone
+class nullSink : public streamSink
+{
+public:
+    void write(const uint8_t *data, uint64_t length) override
+    {
+        (void)data;
+        (void)length;
+    }
+
+    void writeIdle(uint64_t length) override
+    {
+        (void)length;
+    }
+};
+
+// Reduces the stream to its CRC-32 and size, to compare captures without storing them
+class hashSink : public streamSink
+{
+private:
+    uint32_t crc{0xFFFFFFFF};
+    uint64_t bytes{0};
+
+public:
+    void write(const uint8_t *data, uint64_t length) override
+    {
+        crc = crc32Engine::update(crc, data, length);
+        bytes += length;
+    }
+
+    void end() override
+    {
+        console() << "Stream CRC-32: 0x" << hex << setw(8) << setfill('0') << getCrc() << dec << " over " << bytes << " bytes" << endl;
+    }
+
+    uint32_t getCrc() const { return crc ^ 0xFFFFFFFF; }
+    uint64_t getBytes() const { return bytes; }
+};
+
+// Hands every chunk to a user-provided function
+class callbackSink : public streamSink
+{
+private:
+    function<void(const uint8_t *, uint64_t)> callback;
+
+public:
+    callbackSink(function<void(const uint8_t *, uint64_t)> Callback) : callback(move(Callback))
+    {
+    }
+
+    void write(const uint8_t *data, uint64_t length) override
+    {
+        callback(data, length);
+    }
+};
+
+// Writes the stream as a pcapng capture. Preamble and IFGs are stripped and every frame is stamped with
+// the time its preamble starts on the wire, i.e. its byte offset in the stream at the line rate.
+class pcapngSink : public streamSink
+{
+private:
+    string fileName;
+    uint64_t lineRate; // Line rate in Gbps, i.e. bits per nanosecond
+    unique_ptr<pcapngWriter> capture;
+    streamDeframer deframer;
+
+public:
+    pcapngSink(const string &FileName, uint64_t LineRate)
+        : fileName(FileName), lineRate(LineRate),
+          deframer([this](const uint8_t *frame, uint64_t length, uint64_t streamOffset)
+                   { capture->writeFrame(frame, length, streamOffset * 8 / lineRate); })
+    {
+        if (lineRate == 0)
+        {
+            throw runtime_error("Eth.LineRate must be positive to timestamp a capture");
+        }
+    }
+
+    void begin(uint64_t totalBytes) override
+    {
+        (void)totalBytes;
+        capture = make_unique<pcapngWriter>(fileName);
+        console() << " Capturing the stream to .\\" << fileName << " (pcapng)" << endl;
+    }
+
+    void write(const uint8_t *data, uint64_t length) override
+    {
+        deframer.feed(data, length);
+    }
+
+    void writeIdle(uint64_t length) override
+    {
+        deframer.skipIdle(length);
+    }
+
+    void end() override
+    {
+        if (!deframer.idle())
+        {
+            throw runtime_error("Malformed stream: the last frame is truncated");
+        }
+        capture->close();
+        console() << " Captured Frames: " << capture->getFrames() << endl;
+    }
+};
+
+// Writes the stream as an RLE container (see rleEncoder)
+class rleSink : public streamSink
+{
+private:
+    string fileName;
+    uint64_t lineRate;
+    uint64_t streamBytes{0};
+    unique_ptr<rleEncoder> encoder;
+
+public:
+    rleSink(const string &FileName, uint64_t LineRate) : fileName(FileName), lineRate(LineRate)
+    {
+    }
+
+    void begin(uint64_t totalBytes) override
+    {
+        streamBytes = totalBytes;
+        encoder = make_unique<rleEncoder>(fileName, totalBytes, lineRate);
+        console() << " Encoding the stream to .\\" << fileName << " (rle)" << endl;
+    }
+
+    void write(const uint8_t *data, uint64_t length) override
+    {
+        encoder->feed(data, length);
+    }
+
+    void writeIdle(uint64_t length) override
+    {
+        encoder->feedIdle(length);
+    }
+
+    void end() override
+    {
+        encoder->close();
+        uint64_t encoded = encoder->getEncodedBytes();
+        console() << " Encoded Bytes: " << encoded << " (" << fixed << setprecision(1) << double(streamBytes) / encoded << "x smaller than binary, "
+             << double(hexEncoder::encodedSize(streamBytes, 0)) / encoded << "x smaller than hex)" << defaultfloat << endl;
+    }
+};
+
+// Restores the exact stream of an RLE container. Literal records are copied and idle records filled with
+// memset, straight into the sink's memory when it has some, otherwise into STREAM_CHUNK_SIZE chunks.
+class rleExpander
+{
+public:
+    struct containerHeader
+    {
+        uint64_t streamBytes;
+        uint64_t lineRate;
+    };
+
+    static bool isContainer(const uint8_t *data, uint64_t length)
+    {
+        return length >= rleEncoder::headerSize && memcmp(data, rleEncoder::magic, sizeof(rleEncoder::magic)) == 0;
+    }
+
+    static containerHeader readHeader(const uint8_t *data, uint64_t length)
+    {
+        if (!isContainer(data, length))
+        {
+            throw runtime_error("Not an RLE container");
+        }
+        containerHeader header{0, 0};
+        for (int i = 7; i >= 0; i--)
+        {
+            header.streamBytes = header.streamBytes << 8 | data[8 + i];
+            header.lineRate = header.lineRate << 8 | data[16 + i];
+        }
+        return header;
+    }
+
+    // Expand the container into `sink`; returns the size of the stream
+    static uint64_t expand(const uint8_t *data, uint64_t length, streamSink &sink)
+    {
+        containerHeader header = readHeader(data, length);
+        const uint8_t *source = data + rleEncoder::headerSize;
+        const uint8_t *end = data + length;
+
+        sink.begin(header.streamBytes);
+        uint8_t *window = sink.directWindow();
+        vector<uint8_t> chunk(window ? 0 : min<uint64_t>(STREAM_CHUNK_SIZE, header.streamBytes));
+        uint64_t position{0}; // Stream bytes restored
+        uint64_t filled{0};   // Bytes waiting in the chunk
+
+        while (source < end)
+        {
+            uint64_t record{0};
+            for (int shift = 0;; shift += 7)
+            {
+                if (source == end || shift > 63)
+                {
+                    throw runtime_error("Corrupt RLE container: truncated record");
+                }
+                record |= uint64_t(*source & 0x7F) << shift;
+                if (!(*source++ & 0x80))
+                {
+                    break;
+                }
+            }
+            bool idle = record & 1;
+            uint64_t count = record >> 1;
+            if (count > header.streamBytes - position || (!idle && count > static_cast<uint64_t>(end - source)))
+            {
+                throw runtime_error("Corrupt RLE container: record past the end of the stream");
+            }
+            if (window)
+            {
+                idle ? memset(window + position, 0x07, count) : memcpy(window + position, source, count);
+                position += count;
+                source += idle ? 0 : count;
+                continue;
+            }
+            while (count > 0)
+            {
+                uint64_t take = min<uint64_t>(count, chunk.size() - filled);
+                idle ? memset(chunk.data() + filled, 0x07, take) : memcpy(chunk.data() + filled, source, take);
+                filled += take;
+                position += take;
+                count -= take;
+                source += idle ? 0 : take;
+                if (filled == chunk.size())
+                {
+                    sink.write(chunk.data(), filled);
+                    filled = 0;
+                }
+            }
+        }
+        if (position != header.streamBytes)
+        {
+            throw runtime_error("Corrupt RLE container: " + to_string(position) + " of " + to_string(header.streamBytes) + " stream bytes");
+        }
+        if (filled > 0)
+        {
+            sink.write(chunk.data(), filled);
+        }
+        sink.end();
+        return position;
+    }
+};
+
+// Splits the stream into segment files of a fixed number of stream bytes, i.e. a fixed wire time at the
+// line rate, named <stem>_<index><extension>. The generator only copies each chunk into a small ring of
+// buffers; a background thread writes the segments, so generation goes on while they reach the disk. A
+// segment is written as <name>.part and renamed once complete, so another process can take it as soon as
+// its final name appears. In hex and bin every segment holds exactly its byte range of the stream (a frame
+// may continue in the next segment); in pcapng it holds the frames whose preamble starts in its range,
+// stamped with their time since the start of the stream.
+class segmentSink : public streamSink
+{
+private:
+    string fileName;
+    string format;
+    uint64_t lineRate;
+    uint64_t segmentBytes;
+    uint64_t segments{0};
+    int nameWidth{1};
+
+    // Chunks handed over to the writer thread
+    vector<vector<uint8_t>> buffers;
+    vector<uint64_t> lengths;
+    uint64_t queued{0};  // Chunks handed over so far
+    uint64_t written{0}; // Chunks the writer has finished with
+    bool finished{false};
+    exception_ptr failure;
+    mutex queueMutex;
+    condition_variable queueChanged;
+    thread writer;
+
+    // Writer state
+    uint64_t position{0};      // Stream offset of the next byte to write
+    uint64_t openSegment{0};   // Index of the segment being written
+    bool segmentOpen{false};
+    ofstream file;
+    uint8_t counter{0};        // Bytes already written on the current hex line
+    unique_ptr<pcapngWriter> capture;
+    streamDeframer deframer;
+    uint64_t completed{0};
+
+    string segmentName(uint64_t index) const
+    {
+        size_t dot = fileName.find_last_of('.');
+        size_t slash = fileName.find_last_of("/\\");
+        bool hasExtension = dot != string::npos && (slash == string::npos || dot > slash);
+        ostringstream name;
+        name << (hasExtension ? fileName.substr(0, dot) : fileName) << "_" << setw(nameWidth) << setfill('0') << index
+             << (hasExtension ? fileName.substr(dot) : "");
+        return name.str();
+    }
+
+    void openSegmentFile(uint64_t index)
+    {
+        openSegment = index;
+        segmentOpen = true;
+        string name = segmentName(index) + ".part";
+        if (format == "pcapng")
+        {
+            capture = make_unique<pcapngWriter>(name);
+            return;
+        }
+        counter = position % 4; // Hex lines run on across segments, so the segments join into packets.txt
+        file.open(name, format == "bin" ? ios::out | ios::binary : ios::out);
+        if (!file)
+        {
+            throw runtime_error("Failed to open output file " + name);
+        }
+    }
+
+    void closeSegmentFile()
+    {
+        if (format == "pcapng")
+        {
+            capture->close();
+        }
+        else
+        {
+            file.close();
+            if (!file)
+            {
+                throw runtime_error("Failed to write segment " + segmentName(openSegment));
+            }
+        }
+        filesystem::rename(segmentName(openSegment) + ".part", segmentName(openSegment));
+        segmentOpen = false;
+        completed++;
+    }
+
+    // Runs on the writer thread
+    void writeChunk(const uint8_t *data, uint64_t length)
+    {
+        if (format == "pcapng")
+        {
+            deframer.feed(data, length);
+            return;
+        }
+        while (length > 0)
+        {
+            if (!segmentOpen)
+            {
+                openSegmentFile(position / segmentBytes);
+            }
+            uint64_t take = min(length, (openSegment + 1) * segmentBytes - position);
+            if (format == "bin")
+            {
+                file.write(reinterpret_cast<const char *>(data), static_cast<streamsize>(take));
+            }
+            else
+            {
+                writeHexLines(file, data, take, counter);
+            }
+            data += take;
+            length -= take;
+            position += take;
+            if (position == (openSegment + 1) * segmentBytes)
+            {
+                closeSegmentFile();
+            }
+        }
+    }
+
+    void writeSegments()
+    {
+        try
+        {
+            for (;;)
+            {
+                uint64_t slot;
+                {
+                    unique_lock<mutex> lock(queueMutex);
+                    queueChanged.wait(lock, [this]
+                                      { return written < queued || finished; });
+                    if (written == queued)
+                    {
+                        break;
+                    }
+                    slot = written % buffers.size();
+                }
+                writeChunk(buffers[slot].data(), lengths[slot]);
+                lock_guard<mutex> lock(queueMutex);
+                written++;
+                queueChanged.notify_all();
+            }
+            if (segmentOpen)
+            {
+                closeSegmentFile();
+            }
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(queueMutex);
+            failure = current_exception();
+            finished = true;
+            queueChanged.notify_all();
+        }
+    }
+
+    void stopWriter()
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            finished = true;
+            queueChanged.notify_all();
+        }
+        if (writer.joinable())
+        {
+            writer.join();
+        }
+    }
+
+public:
+    segmentSink(const string &FileName, const string &Format, uint64_t LineRate, uint64_t SegmentBytes)
+        : fileName(FileName), format(Format), lineRate(LineRate), segmentBytes(SegmentBytes),
+          buffers(SEGMENT_WRITER_BUFFERS), lengths(SEGMENT_WRITER_BUFFERS),
+          deframer([this](const uint8_t *frame, uint64_t length, uint64_t streamOffset)
+                   {
+                       if (!segmentOpen || streamOffset / segmentBytes != openSegment)
+                       {
+                           if (segmentOpen)
+                           {
+                               closeSegmentFile();
+                           }
+                           openSegmentFile(streamOffset / segmentBytes);
+                       }
+                       capture->writeFrame(frame, length, streamOffset * 8 / lineRate);
+                   })
+    {
+        if (segmentBytes == 0)
+        {
+            throw runtime_error("A segment must hold at least one byte");
+        }
+        if (format == "pcapng" && lineRate == 0)
+        {
+            throw runtime_error("Eth.LineRate must be positive to timestamp a capture");
+        }
+    }
+
+    ~segmentSink() override
+    {
+        stopWriter();
+    }
+
+    // Stream bytes per segment from "<n>ms", "<n>us", "<n>KB", "<n>MB", "<n>GB" or a plain byte count
+    static uint64_t parseSize(const string &size, uint64_t lineRate)
+    {
+        static const vector<pair<string, uint64_t>> units{{"ms", 0}, {"us", 0}, {"KB", 1ULL << 10}, {"MB", 1ULL << 20}, {"GB", 1ULL << 30}};
+        for (const auto &unit : units)
+        {
+            if (size.size() > unit.first.size() && size.compare(size.size() - unit.first.size(), string::npos, unit.first) == 0)
+            {
+                uint64_t count = convertIntoInteger(size.substr(0, size.size() - unit.first.size()));
+                if (unit.second)
+                {
+                    return count * unit.second;
+                }
+                // A line rate in Gbps carries lineRate / 8 bytes per nanosecond
+                return count * (unit.first == "ms" ? 1000000 : 1000) * lineRate / 8;
+            }
+        }
+        return convertIntoInteger(size);
+    }
+
+    void begin(uint64_t totalBytes) override
+    {
+        segments = (totalBytes + segmentBytes - 1) / segmentBytes;
+        nameWidth = static_cast<int>(to_string(max<uint64_t>(segments, 1) - 1).size());
+        position = 0;
+        completed = 0;
+        queued = written = 0;
+        finished = false;
+        console() << " Streaming the stream to " << segments << " segments of " << segmentBytes << " bytes, .\\" << segmentName(0)
+             << " onwards (" << format << ")" << endl;
+        writer = thread(&segmentSink::writeSegments, this);
+    }
+
+    void write(const uint8_t *data, uint64_t length) override
+    {
+        uint64_t slot;
+        {
+            // Wait for a free buffer; the writer falls behind only when the disk is slower than generation
+            unique_lock<mutex> lock(queueMutex);
+            queueChanged.wait(lock, [this]
+                              { return queued - written < buffers.size() || failure; });
+            if (failure)
+            {
+                rethrow_exception(failure);
+            }
+            slot = queued % buffers.size();
+        }
+        buffers[slot].assign(data, data + length);
+        lengths[slot] = length;
+        lock_guard<mutex> lock(queueMutex);
+        queued++;
+        queueChanged.notify_all();
+    }
+
+    void end() override
+    {
+        stopWriter();
+        if (failure)
+        {
+            rethrow_exception(failure);
+        }
+        if (format == "pcapng" && !deframer.idle())
+        {
+            throw runtime_error("Malformed stream: the last frame is truncated");
+        }
+        console() << " Segments Written: " << completed << endl;
+    }
+};
+
+#ifndef _WIN32
+// Layout of the shared-memory ring: this header, the descriptor ring, then the data ring. The producer
+// only writes head, finished and its heartbeat, the consumer only writes tail, dataTail and its heartbeat,
+// and each side keeps its counters on its own cache line. Counters only grow; a position modulo the ring
+// size gives the slot. Each side fails once the other's heartbeat stops while it waits for it.
+struct shmRingHeader
+{
+    static constexpr uint64_t magicValue = 0x474E49524E41524FULL; // "ORANRING"
+    static constexpr uint32_t versionValue = 2;
+
+    atomic<uint64_t> magic;   // Stored last, once the ring is initialized
+    uint32_t version;
+    uint32_t descriptorCount; // Power of two
+    uint64_t dataBytes;
+    uint64_t lineRate;        // Gbps, to turn stream offsets into wire times
+
+    alignas(64) atomic<uint64_t> head; // Descriptors published
+    atomic<uint64_t> finished;          // Non-zero once the last frame is published
+    atomic<uint64_t> producerHeartbeat; // Advanced by the producer while it runs
+
+    alignas(64) atomic<uint64_t> tail; // Descriptors consumed
+    atomic<uint64_t> dataTail;          // Data position up to which frames were released
+    atomic<uint64_t> consumerHeartbeat; // Zero until a consumer attaches, then advanced by it while it runs
+};
+static_assert(atomic<uint64_t>::is_always_lock_free, "the ring counters must be lock-free to be shared between processes");
+
+// A frame published in the ring
+struct shmFrameDescriptor
+{
+    uint64_t position;     // Position of the frame in the data ring; frames never wrap around its end
+    uint64_t streamOffset; // Offset of the frame's preamble in the stream
+    uint32_t length;       // MAC header through FCS
+    uint32_t reserved;
+};
+
+// A POSIX shared-memory segment holding a frame ring, created by the producer or attached by a consumer
+class shmRing
+{
+private:
+    string name;
+    int fd{-1};
+    uint8_t *mapping{nullptr};
+    uint64_t mappedBytes{0};
+    bool owner{false}; // Whether this side created the segment and has to remove its name
+
+    static constexpr uint64_t descriptorsOffset = (sizeof(shmRingHeader) + 63) & ~uint64_t(63);
+
+    void map(int protection)
+    {
+        void *address = mmap(nullptr, mappedBytes, protection, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            throw runtime_error("Failed to map the shared-memory ring " + name);
+        }
+        mapping = static_cast<uint8_t *>(address);
+    }
+
+public:
+    ~shmRing()
+    {
+        if (mapping)
+        {
+            munmap(mapping, mappedBytes);
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        unlink();
+    }
+
+    // Remove the segment's name if this side created it; attached processes keep their mapping
+    void unlink()
+    {
+        if (owner)
+        {
+            shm_unlink(name.c_str());
+            owner = false;
+        }
+    }
+
+    // Create a fresh ring, replacing a segment left behind by an earlier run
+    void create(const string &Name, uint64_t descriptorCount, uint64_t dataBytes, uint64_t lineRate)
+    {
+        name = Name;
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0)
+        {
+            throw runtime_error("Failed to create the shared-memory ring " + name);
+        }
+        owner = true;
+        mappedBytes = descriptorsOffset + descriptorCount * sizeof(shmFrameDescriptor) + dataBytes;
+        if (ftruncate(fd, static_cast<off_t>(mappedBytes)) != 0)
+        {
+            throw runtime_error("Failed to size the shared-memory ring " + name);
+        }
+        map(PROT_READ | PROT_WRITE);
+
+        shmRingHeader *ring = new (mapping) shmRingHeader{};
+        ring->version = shmRingHeader::versionValue;
+        ring->descriptorCount = static_cast<uint32_t>(descriptorCount);
+        ring->dataBytes = dataBytes;
+        ring->lineRate = lineRate;
+        ring->magic.store(shmRingHeader::magicValue, memory_order_release);
+    }
+
+    // Attach to a ring created by a producer. Returns false while it does not exist or is not initialized.
+    bool attach(const string &Name)
+    {
+        name = Name;
+        fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat status;
+        if (fstat(fd, &status) != 0 || static_cast<uint64_t>(status.st_size) < descriptorsOffset)
+        {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        mappedBytes = static_cast<uint64_t>(status.st_size);
+        map(PROT_READ | PROT_WRITE);
+        if (header()->magic.load(memory_order_acquire) != shmRingHeader::magicValue)
+        {
+            munmap(mapping, mappedBytes);
+            mapping = nullptr;
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        if (header()->version != shmRingHeader::versionValue)
+        {
+            throw runtime_error("Unsupported shared-memory ring version in " + name);
+        }
+        return true;
+    }
+
+    shmRingHeader *header() const { return reinterpret_cast<shmRingHeader *>(mapping); }
+    shmFrameDescriptor *descriptors() const { return reinterpret_cast<shmFrameDescriptor *>(mapping + descriptorsOffset); }
+    uint8_t *data() const { return mapping + descriptorsOffset + header()->descriptorCount * sizeof(shmFrameDescriptor); }
+
+    // Wait a little longer each time the other side has not moved yet
+    static void backoff(unsigned &spins)
+    {
+        if (++spins < 64)
+        {
+#ifdef HAVE_X86_INTRINSICS
+            _mm_pause();
+#endif
+        }
+        else
+        {
+            this_thread::yield();
+        }
+    }
+};
+
+// Publishes the frames of the stream into a single-producer/single-consumer ring in POSIX shared memory,
+// so another process on the host can take them without going through a file. Preamble and IFGs are
+// stripped like in a capture; each descriptor keeps the frame's stream offset so the consumer can
+// recover its wire time. Frames are made visible at the end of every chunk, or earlier when the ring is
+// full, in which case the generator waits for the consumer (backpressure). end() waits until the
+// consumer has taken every frame, then removes the ring's name. A consumer that does not attach, or stops
+// advancing its heartbeat, for `timeout` seconds while the generator waits for it fails the run.
+class shmRingSink : public streamSink
+{
+private:
+    string name;
+    uint64_t lineRate;
+    uint64_t timeout;       // Seconds, 0 to wait for the consumer forever
+    shmRing ring;
+    streamDeframer deframer;
+    shmRingHeader *shared{nullptr};
+    shmFrameDescriptor *descriptors{nullptr};
+    uint8_t *data{nullptr};
+    uint64_t head{0};       // Descriptors written, published to the consumer by publish()
+    uint64_t dataHead{0};   // Data position behind the last frame written
+    uint64_t tail{0};       // Last seen consumer counters
+    uint64_t dataTail{0};
+    uint64_t stalls{0};     // Times the ring was full
+    uint64_t beats{0};      // Producer heartbeat
+    uint64_t lastBeat{0};   // Consumer heartbeat last seen, and when it changed
+    chrono::steady_clock::time_point lastSeen;
+    bool announced{false};  // Whether "waiting for a consumer" was printed
+
+    void publish()
+    {
+        shared->head.store(head, memory_order_release);
+        shared->producerHeartbeat.store(++beats, memory_order_release);
+    }
+
+    // Wait until a descriptor is free and the data ring is released up to `dataEnd`
+    void reserve(uint64_t dataEnd)
+    {
+        if (head - tail < shared->descriptorCount && dataEnd - dataTail <= shared->dataBytes)
+        {
+            return;
+        }
+        publish();
+        stalls++;
+        unsigned spins = 0;
+        while (true)
+        {
+            tail = shared->tail.load(memory_order_acquire);
+            dataTail = shared->dataTail.load(memory_order_acquire);
+            if (head - tail < shared->descriptorCount && dataEnd - dataTail <= shared->dataBytes)
+            {
+                return;
+            }
+            awaitConsumer(spins);
+        }
+    }
+
+    // Back off while the consumer catches up. Once it has shown no sign of life (attaching, then advancing
+    // its heartbeat) for `timeout` seconds, the ring's name is removed, so no stale segment is left behind,
+    // and the run fails.
+    void awaitConsumer(unsigned &spins)
+    {
+        shmRing::backoff(spins);
+        shared->producerHeartbeat.store(++beats, memory_order_release);
+        uint64_t beat = shared->consumerHeartbeat.load(memory_order_acquire);
+        auto now = chrono::steady_clock::now();
+        if (beat != lastBeat)
+        {
+            lastBeat = beat;
+            lastSeen = now;
+            return;
+        }
+        if (beat == 0 && !announced)
+        {
+            console() << " Waiting for a consumer of the shared-memory ring " << name << endl;
+            announced = true;
+        }
+        if (timeout && now - lastSeen > chrono::seconds(timeout))
+        {
+            ring.unlink();
+            throw runtime_error(beat == 0 ? "No consumer attached to the shared-memory ring " + name + " within " + to_string(timeout) + " s"
+                                          : "The consumer of the shared-memory ring " + name + " stopped for " + to_string(timeout) + " s");
+        }
+    }
+
+    void push(const uint8_t *frame, uint64_t length, uint64_t streamOffset)
+    {
+        if (length > shared->dataBytes)
+        {
+            throw runtime_error("Frame larger than the shared-memory ring");
+        }
+
+        // A frame that would cross the end of the data ring starts over at its beginning
+        uint64_t position = dataHead;
+        uint64_t offset = position % shared->dataBytes;
+        if (offset + length > shared->dataBytes)
+        {
+            position += shared->dataBytes - offset;
+        }
+        uint64_t end = (position + length + 7) & ~uint64_t(7);
+        reserve(end);
+
+        memcpy(data + position % shared->dataBytes, frame, length);
+        descriptors[head % shared->descriptorCount] = shmFrameDescriptor{position, streamOffset, static_cast<uint32_t>(length), 0};
+        head++;
+        dataHead = end;
+    }
+
+public:
+    shmRingSink(const string &Name, uint64_t LineRate, uint64_t Timeout = SHM_PEER_TIMEOUT)
+        : name(Name), lineRate(LineRate), timeout(Timeout),
+          deframer([this](const uint8_t *frame, uint64_t length, uint64_t streamOffset)
+                   { push(frame, length, streamOffset); })
+    {
+    }
+
+    void begin(uint64_t totalBytes) override
+    {
+        (void)totalBytes;
+        ring.create(name, SHM_RING_DESCRIPTORS, SHM_RING_DATA_BYTES, lineRate);
+        shared = ring.header();
+        descriptors = ring.descriptors();
+        data = ring.data();
+        lastSeen = chrono::steady_clock::now();
+        console() << " Publishing the frames to the shared-memory ring " << name << endl;
+    }
+
+    void write(const uint8_t *chunk, uint64_t length) override
+    {
+        deframer.feed(chunk, length);
+        publish();
+    }
+
+    void end() override
+    {
+        if (!deframer.idle())
+        {
+            throw runtime_error("Malformed stream: the last frame is truncated");
+        }
+        publish();
+        shared->finished.store(1, memory_order_release);
+
+        // The frames are only delivered once the consumer has taken them
+        unsigned spins = 0;
+        while (shared->tail.load(memory_order_acquire) != head)
+        {
+            awaitConsumer(spins);
+        }
+        console() << " Published Frames: " << head << " (ring full " << stalls << " times)" << endl;
+    }
+};
+
+// Reference consumer of a shmRingSink: attaches to the ring (waiting for the producer to create it),
+// takes every frame, checks its FCS and the order of the stream offsets, and prints a summary. Returns
+// false when a frame is corrupt. Both sides advance a heartbeat; once attached, the consumer fails when
+// the producer's has not moved for `timeout` seconds (0 waits forever) while no frame arrives.
+bool consumeShmRing(const string &name, uint64_t timeout = SHM_PEER_TIMEOUT)
+{
+    shmRing ring;
+    unsigned spins = 0;
+    while (!ring.attach(name))
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    shmRingHeader *shared = ring.header();
+    const shmFrameDescriptor *descriptors = ring.descriptors();
+    const uint8_t *data = ring.data();
+    cout << "========= Consuming " << name << " =========" << endl;
+
+    uint64_t beats = shared->consumerHeartbeat.load(memory_order_relaxed);
+    shared->consumerHeartbeat.store(++beats, memory_order_release);
+    uint64_t producerBeat = shared->producerHeartbeat.load(memory_order_acquire);
+    auto producerSeen = chrono::steady_clock::now();
+    uint64_t tail = shared->tail.load(memory_order_relaxed);
+    uint64_t frames{0}, bytes{0}, fcsErrors{0}, orderErrors{0}, lastOffset{0};
+    auto start = chrono::steady_clock::now(); // Reset when the first frame arrives
+    while (true)
+    {
+        shared->consumerHeartbeat.store(++beats, memory_order_release);
+        uint64_t head = shared->head.load(memory_order_acquire);
+        if (tail == head)
+        {
+            if (shared->finished.load(memory_order_acquire) && shared->head.load(memory_order_acquire) == tail)
+            {
+                break;
+            }
+            shmRing::backoff(spins);
+            uint64_t beat = shared->producerHeartbeat.load(memory_order_acquire);
+            auto now = chrono::steady_clock::now();
+            if (beat != producerBeat)
+            {
+                producerBeat = beat;
+                producerSeen = now;
+            }
+            else if (timeout && now - producerSeen > chrono::seconds(timeout))
+            {
+                throw runtime_error("The producer of the shared-memory ring " + name + " stopped for " + to_string(timeout) + " s");
+            }
+            continue;
+        }
+        spins = 0;
+        if (frames == 0)
+        {
+            start = chrono::steady_clock::now();
+        }
+
+        uint64_t released = 0;
+        for (; tail < head; tail++)
+        {
+            const shmFrameDescriptor &descriptor = descriptors[tail % shared->descriptorCount];
+            const uint8_t *frame = data + descriptor.position % shared->dataBytes;
+            uint32_t crc = crc32Engine::update(0xFFFFFFFF, frame, descriptor.length - 4) ^ 0xFFFFFFFF;
+            const uint8_t *fcs = frame + descriptor.length - 4;
+            if (crc != ((uint32_t(fcs[0]) << 24) | (uint32_t(fcs[1]) << 16) | (uint32_t(fcs[2]) << 8) | fcs[3]))
+            {
+                fcsErrors++;
+            }
+            if (frames > 0 && descriptor.streamOffset <= lastOffset)
+            {
+                orderErrors++;
+            }
+            lastOffset = descriptor.streamOffset;
+            frames++;
+            bytes += descriptor.length;
+            released = (descriptor.position + descriptor.length + 7) & ~uint64_t(7);
+        }
+        shared->dataTail.store(released, memory_order_release);
+        shared->tail.store(tail, memory_order_release);
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Consumed Frames: " << frames << endl;
+    cout << "Consumed Bytes: " << bytes << " (" << fixed << setprecision(2) << (seconds > 0 ? bytes * 8 / seconds / 1e9 : 0.0)
+         << " Gbps)" << defaultfloat << endl;
+    if (frames > 0 && shared->lineRate > 0)
+    {
+        cout << "Last Frame On The Wire At: " << lastOffset * 8 / shared->lineRate << " ns" << endl;
+    }
+    cout << "FCS Errors: " << fcsErrors << endl;
+    cout << "Out Of Order Frames: " << orderErrors << endl;
+    cout << "========= Done Consuming =========" << endl;
+    return fcsErrors == 0 && orderErrors == 0;
+}
+#endif
+
+// One eAxC of one carrier. Its packets carry its eAxC ID, have their own sequence counter, take their IQ
+// samples from their own source and may carry a VLAN tag; the flows are interleaved symbol by symbol.
+struct streamFlow
+{
+    uint16_t eaxcId;          // ecpriRTCid/ecpriPcid: carrier in the upper byte, RU port in the lower byte
+    uint64_t source;          // Index of its IQ samples among the Oran.Payload files (fixed payload)
+    randomIqGenerator random; // Its random payload (random payload)
+    vlanTag tag;
+};
+
+// One packet of a symbol: the PRBs it carries and where its samples and its frame sit within the symbol
+struct plannedSection
+{
+    uint16_t startPrbu;
+    uint16_t numPrbu;
+    uint64_t sampleOffset; // Offset of its first IQ sample among the samples of the symbol
+    uint64_t payloadBytes; // IQ bytes in the packet, after compression
+    uint64_t frameOffset;  // Offset of its frame among the bytes of the symbol
+};
+
+// Compact description of a generated stream: the kinds of frames it holds, with their size and count, and
+// the IFG run that fills the capture after the last frame. Every symbol carries the same frames, so there
+// is one entry per C-plane flow and per planned packet of every flow, whatever the capture length. The
+// header fields of a frame are closed-form functions of its index, so nothing else is needed to build it.
+// generateStream materializes the bytes only when a sink asks for them, and a sink that does not need the
+// IFG bytes themselves receives the idle run as a length (streamSink::writeIdle).
+class streamDescriptor
+{
+public:
+    struct entry
+    {
+        bool control;        // C-plane message rather than U-plane packet
+        uint16_t eaxcId;
+        uint16_t startPrb;
+        uint16_t numPrb;
+        uint64_t frameBytes; // Preamble, frame and the IFGs that follow it
+        uint64_t frames;     // Frames of this kind in the stream
+    };
+
+    vector<entry> entries; // In the order the frames appear within a symbol
+    uint64_t totalBytes{0};
+    int64_t idleBytes{0}; // IFGs after the last frame (negative when the frames do not fit the capture)
+
+    uint64_t frames() const
+    {
+        uint64_t count = 0;
+        for (const entry &e : entries)
+        {
+            count += e.frames;
+        }
+        return count;
+    }
+
+    void print() const
+    {
+        cout << "========= Stream Plan =========" << endl;
+        cout << left << setw(9) << "Kind" << setw(8) << "eAxC" << setw(11) << "PRBs" << right << setw(12) << "Frame Bytes" << setw(12)
+             << "Frames" << setw(16) << "Bytes" << setw(9) << "Share%" << endl;
+        for (const entry &e : entries)
+        {
+            ostringstream eaxc, prbs, share;
+            eaxc << "0x" << hex << setw(4) << setfill('0') << e.eaxcId;
+            prbs << e.startPrb << "-" << e.startPrb + e.numPrb - 1;
+            share << fixed << setprecision(2) << (totalBytes ? 100.0 * e.frames * e.frameBytes / totalBytes : 0.0);
+            cout << left << setw(9) << (e.control ? "C-Plane" : "U-Plane") << setw(8) << eaxc.str() << setw(11) << prbs.str() << right
+                 << setw(12) << e.frameBytes << setw(12) << e.frames << setw(16) << e.frames * e.frameBytes << setw(9) << share.str() << endl;
+        }
+        ostringstream idleShare;
+        idleShare << fixed << setprecision(2) << (totalBytes ? 100.0 * idleBytes / totalBytes : 0.0);
+        cout << "Total Ethernet Frames: " << frames() << endl;
+        cout << "Total Bytes: " << totalBytes << endl;
+        cout << "Remaining IFGs: " << idleBytes << " (" << idleShare.str() << "%)" << endl;
+        if (idleBytes < 0)
+        {
+            cout << "The frames do not fit the capture (Negative IFGs)" << endl;
+        }
+    }
+};
+
+// Class that handles streaming packets and generating the full packet stream
+class packetStreaming
+{
+private:
+    uint64_t generatedBytes{0};       // Bytes pushed to the sink so far
+    unsigned threads{1};              // Worker threads used to build the frames
+    vector<vector<int8_t>> iqSamples; // IQ samples of every source used in the packets (fixed payload only)
+    bfpCompressor compressor;         // Encodes the IQ samples of a packet (raw or block floating point)
+    uint64_t seed{0};                 // Seed of the random payload
+    payloadCrcCache iqCrcCache;       // CRCs of the IQ slices already seen (fixed payload only)
+    vector<frameTemplateCache> frameTemplates; // Pre-built distinct IQ slices of each fixed-payload source
+    bool templatesEnabled{false};              // Whether the slices of every source are pre-built
+
+    // Flows of the stream, in the order their packets follow each other within a symbol
+    vector<streamFlow> flows;
+    vector<frameBuilder> builders; // Frame builder of each flow
+    uint64_t flowsNo;
+    uint16_t eaxcPerCarrier;
 
     // Configuration and calculation-related variables
     uint64_t lineRate;
@@ -371,268 +4142,2456 @@ private:
     uint16_t nrbPerPacket;
     string payloadType;
 
-    array<uint8_t, 6> destAddress;
-    array<uint8_t, 6> sourceAddress;
+    array<uint8_t, 6> destAddress;
+    array<uint8_t, 6> sourceAddress;
+
+    // Variables for important calculations
+    uint64_t totalTransmisson;
+    double totalFrames;
+    uint64_t packetsPERsymbol; // Packets of all flows in a symbol
+    uint64_t packetsPERslot;
+    uint64_t packetsPERsubframe;
+    uint64_t packetsPERframe;
+    uint64_t slotsPerFrame;
+    uint64_t totalPackets;
+    uint64_t iqSamplesPERpacket;
+    uint64_t payloadBytesPERpacket; // Bytes of IQ data in a packet, after compression
+    uint64_t totalSamples;
+    int64_t IFGsNo;
+
+    // Packets of a flow in every symbol, planned once for the configuration
+    vector<plannedSection> sections;
+    uint64_t sectionsPERflow; // Packets of one flow in a symbol
+    uint64_t flowSymbolBytes; // Bytes of the frames of one flow in one symbol, IFGs included
+    uint64_t symbolBytes;     // Bytes of the frames of all flows in one symbol
+    uint64_t symbolSamples;   // IQ samples carried by one flow in one symbol
+    bool uniformSections;     // Whether every packet carries the same number of PRBs
+    bool fragmented{false};   // Whether NrbPerPacket had to be split to fit Eth.MaxPacketSize
+
+    // C-plane: one section type 1 message per flow and slot, announcing the sections of the plan
+    bool controlPlane{false};
+    uint64_t totalSlots;
+    uint64_t controlAdvance{0};       // Symbols by which the C-plane message of a slot precedes the slot
+    uint64_t controlFrameBytes{0};    // Bytes of one C-plane frame, IFGs included
+    uint64_t controlSlotBytes{0};     // Bytes of the C-plane frames of all flows for one slot
+    uint8_t udCompHdr{0};             // Compression announced by the C-plane messages
+    vector<uint64_t> controlSections; // Sections of every C-plane message, packed by ControlPacket::packSection
+
+    // Packet builder specialized for the numerology and packets per symbol, chosen once
+    using buildFunction = void (packetStreaming::*)(uint64_t, uint64_t, uint64_t, uint8_t *, payloadCrcCache &) const;
+    buildFunction buildKernel{nullptr};
+
+public:
+    // Constructor to initialize the packetStreaming object with configuration and payload data
+    packetStreaming(const parseConfigurations &configuration)
+    {
+        // Assign configuration values to class members
+        lineRate = static_cast<uint64_t>(configuration.LineRate);
+        captureSize = static_cast<uint64_t>(configuration.CaptureSizeMs);
+        minNumOfIFGsPerPacket = configuration.MinNumOfIFGsPerPacket;
+        maxPacketSize = configuration.MaxPacketSize;
+
+        // Convert configuration addresses and size to byte arrays
+        destAddress = intToArray<uint64_t, 6>(configuration.DestAddress);
+        sourceAddress = intToArray<uint64_t, 6>(configuration.SourceAddress);
+
+        scs = static_cast<uint8_t>(configuration.SCS);
+        maxNrb = fixRB(static_cast<uint16_t>(configuration.MaxNrb));
+        nrbPerPacket = fixRB(static_cast<uint16_t>(configuration.NrbPerPacket));
+        payloadType = configuration.PayloadType;
+
+        // Important Calculations
+        totalTransmisson = (lineRate * captureSize * 1000000) / 8;
+
+        // Handle fixed or random payload based on PayloadType
+        if (payloadType == "fixed")
+        {
+            iqSamples = configuration.iqSamples;
+        }
+        else if (payloadType == "random")
+        {
+            // Without Oran.Seed every run differs; the seed is printed so the stream can be reproduced
+            random_device entropy;
+            seed = configuration.HasSeed ? configuration.Seed : (uint64_t(entropy()) << 32) | entropy();
+        }
+        else
+        {
+            throw runtime_error("Wrong PayloadType");
+        }
+
+        // One flow per eAxC of every carrier, carrier by carrier
+        eaxcPerCarrier = configuration.NumEaxc;
+        for (uint16_t carrier = 0; carrier < configuration.NumCarriers; carrier++)
+        {
+            for (uint16_t eaxc = 0; eaxc < configuration.NumEaxc; eaxc++)
+            {
+                uint64_t index = flows.size();
+                streamFlow flow;
+                flow.eaxcId = static_cast<uint16_t>((carrier << 8) | configuration.EaxcIds[eaxc]);
+                flow.source = index % max<size_t>(1, iqSamples.size());
+                flow.random = randomIqGenerator{seed + index * 0x9E3779B97F4A7C15ULL}; // Flow 0 keeps the plain seed
+                flow.tag.present = !configuration.VlanIds.empty();
+                if (flow.tag.present)
+                {
+                    flow.tag.vlanId = configuration.VlanIds[index % configuration.VlanIds.size()];
+                    flow.tag.pcp = configuration.VlanPcps[index % configuration.VlanPcps.size()];
+                }
+                flows.push_back(flow);
+            }
+        }
+        flowsNo = flows.size();
+
+        // Split every symbol into packets that fit the maximum packet size
+        compressor = bfpCompressor{configuration.CompressionWidth};
+        planSections();
+
+        // Perform important calculations based on configuration
+        totalFrames = static_cast<double>(captureSize / FRAME_PERIOD_MS);
+        sectionsPERflow = sections.size();
+        packetsPERsymbol = flowsNo * sectionsPERflow;
+        symbolBytes = flowsNo * flowSymbolBytes;
+        slotsPerFrame = static_cast<uint64_t>(scs / SCS_PERIODICITY);
+        packetsPERslot = static_cast<uint64_t>(packetsPERsymbol * SYMBOL_PER_SLOT);
+        packetsPERsubframe = static_cast<uint64_t>(packetsPERslot * slotsPerFrame);
+        packetsPERframe = static_cast<uint64_t>(packetsPERsubframe * SUBFRAME_PER_FRAME);
+        totalPackets = static_cast<uint64_t>(packetsPERframe * totalFrames);
+        iqSamplesPERpacket = static_cast<uint64_t>(2 * RE_PER_RB * sections[0].numPrbu);
+        totalSamples = static_cast<uint64_t>(flowsNo * symbolSamples * (totalPackets / packetsPERsymbol));
+        payloadBytesPERpacket = sections[0].payloadBytes;
+        buildKernel = selectBuildKernel();
+
+        for (const streamFlow &flow : flows)
+        {
+            builders.emplace_back(destAddress, sourceAddress, minNumOfIFGsPerPacket, payloadBytesPERpacket, flow.tag);
+        }
+
+        totalSlots = totalPackets / packetsPERsymbol / SYMBOL_PER_SLOT;
+        controlPlane = configuration.ControlPlane;
+        if (controlPlane)
+        {
+            if (sectionsPERflow > 255)
+            {
+                throw runtime_error("A C-plane message cannot announce more than 255 sections");
+            }
+            for (const plannedSection &section : sections)
+            {
+                controlSections.push_back(ControlPacket::packSection(section.startPrbu, section.numPrbu));
+            }
+            controlFrameBytes = builders[0].controlFrameSize(sectionsPERflow);
+            if (controlFrameBytes > maxPacketSize)
+            {
+                throw runtime_error("C-plane frame exceeds the maximum allowed size of " + to_string(maxPacketSize) + " bytes.");
+            }
+            controlSlotBytes = flowsNo * controlFrameBytes;
+
+            // BFP is compression method 1, with the mantissa width in the upper nibble (16 bits as 0)
+            udCompHdr = compressor.enabled() ? static_cast<uint8_t>(((compressor.getIqWidth() & 0xF) << 4) | 1) : 0;
+
+            // A symbol lasts 1000 / (slotsPerFrame * SYMBOL_PER_SLOT) microseconds; round the advance up
+            controlAdvance = (configuration.CplaneAdvanceUs * slotsPerFrame * SYMBOL_PER_SLOT + 999) / 1000;
+        }
+    }
+
+    // Set the number of worker threads used by generateStream (0 means one per hardware thread)
+    void setThreads(unsigned Threads)
+    {
+        threads = Threads ? Threads : max(1u, thread::hardware_concurrency());
+    }
+
+    uint64_t getTotalPackets() const { return totalPackets; }
+    uint64_t getControlMessages() const { return controlPlane ? totalSlots * flowsNo : 0; }
+    uint64_t getGeneratedBytes() const { return generatedBytes; }
+    int64_t getRemainingIfgs() const { return IFGsNo; }
+
+    // Describe the stream without building it
+    streamDescriptor describeStream() const
+    {
+        streamDescriptor stream;
+        stream.totalBytes = totalTransmisson;
+        stream.idleBytes = static_cast<int64_t>(totalTransmisson - packetOffset(totalPackets));
+        uint64_t totalSymbols = totalPackets / packetsPERsymbol;
+        for (uint64_t flow = 0; flow < flowsNo; flow++)
+        {
+            if (controlPlane)
+            {
+                stream.entries.push_back({true, flows[flow].eaxcId, 0, maxNrb, controlFrameBytes, totalSlots});
+            }
+        }
+        for (uint64_t flow = 0; flow < flowsNo; flow++)
+        {
+            for (const plannedSection &section : sections)
+            {
+                stream.entries.push_back({false, flows[flow].eaxcId, section.startPrbu, section.numPrbu,
+                                          builders[flow].frameSize(section.payloadBytes), totalSymbols});
+            }
+        }
+        return stream;
+    }
+
+    // Method to construct the full stream of packets and IFGs in memory
+    vector<uint8_t> generateStream()
+    {
+        memorySink memory;
+        generateStream(memory);
+        return move(memory.getStream()); // Return the generated packet stream
+    }
+
+    // Method to generate the full stream of packets and IFGs into a sink, one chunk at a time
+    void generateStream(streamSink &sink)
+    {
+        console() << "========= Start Generating the Stream =========" << endl;
+
+        // Every symbol has the same frames, so the remaining IFGs are known before generating
+        IFGsNo = static_cast<int64_t>(totalTransmisson - packetOffset(totalPackets));
+        if (IFGsNo < 0)
+        {
+            throw runtime_error("Negative IFGs");
+        }
+
+        // A fixed payload only contains a few distinct IQ slices per source: build them once up front
+        frameTemplates.assign(iqSamples.size(), frameTemplateCache{});
+        templatesEnabled = false;
+        if (payloadType == "fixed" && uniformSections)
+        {
+            templatesEnabled = true;
+            for (size_t source = 0; source < iqSamples.size(); source++)
+            {
+                templatesEnabled &= frameTemplates[source].build(iqSamples[source], iqSamplesPERpacket, totalPackets / flowsNo,
+                                                                 FRAME_TEMPLATE_CACHE_MAX_BYTES / iqSamples.size(), compressor);
+            }
+        }
+
+        // Work is split into units of whole symbols that fill about one chunk
+        uint64_t totalSymbols = totalPackets / packetsPERsymbol;
+        uint64_t unitSymbols = max<uint64_t>(1, STREAM_CHUNK_SIZE / symbolBytes);
+        uint64_t units = (totalSymbols + unitSymbols - 1) / unitSymbols;
+        uint64_t unitBytes = maxUnitBytes(unitSymbols);
+
+        generatedBytes = 0;
+        sink.begin(totalTransmisson);
+
+        // Sinks that hold the whole stream let the frames be built straight at their final offset
+        uint8_t *window = sink.directWindow();
+
+        if (threads <= 1)
+        {
+            static thread_local vector<uint8_t> chunk; // Kept from one run to the next on this thread
+            if (!window && chunk.size() < unitBytes)
+            {
+                chunk.resize(unitBytes);
+            }
+            for (uint64_t unit = 0; unit < units; unit++)
+            {
+                uint64_t first = unit * unitSymbols;
+                uint64_t last = min(first + unitSymbols, totalSymbols);
+                uint8_t *destination = window ? window + symbolOffset(first) : chunk.data();
+                for (uint64_t flow = 0; flow < flowsNo; flow++)
+                {
+                    buildPackets(flow, first, last, destination, iqCrcCache);
+                }
+                uint64_t bytes = symbolOffset(last) - symbolOffset(first);
+                if (!window)
+                {
+                    scopedStage timer{stage::streamAppend, bytes};
+                    sink.write(chunk.data(), bytes);
+                }
+                generatedBytes += bytes;
+            }
+        }
+        else
+        {
+            generateParallel(sink, window, unitSymbols, units, unitBytes);
+        }
+
+        // Fill the rest of the capture with IFG bytes (0x07)
+        if (window)
+        {
+            scopedStage timer{stage::streamAppend, static_cast<uint64_t>(IFGsNo)};
+            memset(window + generatedBytes, 0x07, IFGsNo);
+            generatedBytes += IFGsNo;
+        }
+        else
+        {
+            scopedStage timer{stage::streamAppend, static_cast<uint64_t>(IFGsNo)};
+            sink.writeIdle(IFGsNo);
+            generatedBytes += IFGsNo;
+        }
+        {
+            scopedStage timer{stage::exportStream};
+            sink.end();
+        }
+
+        // Print generation details
+        if (flowsNo > 1)
+        {
+            console() << "Flows: " << flowsNo << " (" << eaxcPerCarrier << " eAxCs x " << flowsNo / eaxcPerCarrier << " carriers)";
+            if (flows[0].tag.present)
+            {
+                console() << ", VLAN tagged";
+            }
+            console() << endl;
+            console() << "Packets/Symbol/Flow: " << sectionsPERflow << endl;
+        }
+        else if (flows[0].tag.present)
+        {
+            console() << "VLAN: " << flows[0].tag.vlanId << ", PCP " << unsigned(flows[0].tag.pcp) << endl;
+        }
+        console() << "Packets/Symbol: " << packetsPERsymbol << endl;
+        if (controlPlane)
+        {
+            console() << "C-Plane Messages: " << getControlMessages() << " (" << controlFrameBytes << " bytes, " << sectionsPERflow
+                 << " sections each), " << controlAdvance << " symbols ahead of their slot" << endl;
+        }
+        if (fragmented)
+        {
+            console() << "Fragmentation: " << nrbPerPacket << " PRBs/packet exceed " << maxPacketSize << " bytes, each symbol's "
+                 << maxNrb << " PRBs are split into " << sectionsPERflow << " packets of " << sections.back().numPrbu;
+            if (!uniformSections)
+            {
+                console() << "-" << sections.front().numPrbu;
+            }
+            console() << " PRBs" << endl;
+        }
+        console() << "Packets/Slot: " << packetsPERslot << endl;
+        console() << "Packets/Subframe: " << packetsPERsubframe << endl;
+        console() << "Packets/Frame: " << packetsPERframe << endl;
+        console() << "IQ Samples/Packet: " << iqSamplesPERpacket << endl;
+        if (compressor.enabled())
+        {
+            console() << "Compression: BFP, " << unsigned(compressor.getIqWidth()) << "-bit mantissas" << endl;
+            console() << "IQ Bytes/Packet: " << payloadBytesPERpacket << " (uncompressed " << iqSamplesPERpacket << ")" << endl;
+        }
+        console() << "Total Bytes: " << totalTransmisson << endl;
+        console() << "Total Generated: " << generatedBytes << endl;
+        console() << "Total Frames: " << totalFrames << endl;
+        console() << "Total Packets: " << totalPackets << endl;
+        console() << "Total IQ Samples: " << totalSamples << endl;
+        console() << "Remaining IFGs: " << IFGsNo << endl;
+        if (payloadType == "random")
+        {
+            console() << "Random Payload Seed: 0x" << hex << seed << dec << endl;
+        }
+        if (templatesEnabled)
+        {
+            uint64_t served = totalPackets;
+            uint64_t built = 0;
+            uint64_t memory = 0;
+            for (const frameTemplateCache &templates : frameTemplates)
+            {
+                built += templates.getTemplates();
+                memory += templates.getMemory();
+            }
+            console() << "Frame Template Period (Packets): " << frameTemplates[0].getPeriod() << endl;
+            console() << "Frame Templates Built: " << built << " (" << memory << " bytes)" << endl;
+            ostringstream hitRate;
+            hitRate << fixed << setprecision(2) << (served ? 100.0 * (served - built) / served : 0.0);
+            console() << "Frame Template Cache Hit Rate: " << hitRate.str() << "% (" << served - built << "/" << served << ")" << endl;
+        }
+        else if (payloadType == "fixed")
+        {
+            if (uniformSections)
+            {
+                console() << "Frame Template Period (Packets): " << frameTemplates[0].getPeriod() << " (template cache not used)" << endl;
+            }
+            else
+            {
+                console() << "Frame Template Cache: not used (packets carry different PRB counts)" << endl;
+            }
+            console() << "Payload CRC Cache Hits/Misses: " << iqCrcCache.getHits() << "/" << iqCrcCache.getMisses() << endl;
+        }
+        console() << "========= Done Generating the Stream =========" << endl;
+    }
+
+    // Header fields of a packet of a flow, as closed-form functions of its index `packetNo` among the packets
+    // of the flow. The symbol counter advances after every packet whose index is a non-zero multiple of
+    // sectionsPERflow, and the eCPRI sequence ID of a packet is the previous packet index of the flow modulo
+    // 255. Non-zero template arguments replace slotsPerFrame and sectionsPERflow with constants, so the
+    // divisions compile to multiplications.
+    template <uint64_t SlotsPerFrame = 0, uint64_t PacketsPerSymbol = 0>
+    packetHeaderFields fieldsOf(uint64_t flow, uint64_t packetNo) const
+    {
+        const uint64_t slots = SlotsPerFrame ? SlotsPerFrame : slotsPerFrame;
+        const uint64_t perSymbol = PacketsPerSymbol ? PacketsPerSymbol : sectionsPERflow;
+        uint64_t symbolCount = packetNo == 0 ? 0 : (packetNo - 1) / perSymbol;
+        uint64_t slotCount = symbolCount / SYMBOL_PER_SLOT;
+        uint64_t subframeCount = slotCount / slots;
+
+        packetHeaderFields fields;
+        fields.frameId = static_cast<uint8_t>((subframeCount / SUBFRAME_PER_FRAME) % 256);
+        fields.subframeId = static_cast<uint8_t>(subframeCount % SUBFRAME_PER_FRAME);
+        fields.slotId = static_cast<uint8_t>(slotCount % slots);
+        fields.symbolId = static_cast<uint8_t>(symbolCount % SYMBOL_PER_SLOT);
+        const plannedSection &section = sections[packetNo % perSymbol];
+        fields.startPrbu = section.startPrbu;
+        fields.numPrbu = section.numPrbu;
+        fields.ecpriSeqid = static_cast<uint16_t>(packetNo == 0 ? 0 : (packetNo - 1) % 255);
+        fields.eaxcId = flows[flow].eaxcId;
+        return fields;
+    }
+
+    // C-plane messages of each flow sent before the symbol `symbol`. The message of slot n goes out at the
+    // start of symbol n * SYMBOL_PER_SLOT - controlAdvance, or at the start of the stream when that symbol
+    // comes before it.
+    uint64_t controlSlotsBefore(uint64_t symbol) const
+    {
+        if (!controlPlane || symbol == 0)
+        {
+            return 0;
+        }
+        return min(totalSlots, (symbol - 1 + controlAdvance) / SYMBOL_PER_SLOT + 1);
+    }
+
+    // Offset in the stream of the start of a symbol (or of the end of the stream for the symbol count). A
+    // symbol starts with the C-plane frames sent at that symbol, flow by flow, followed by its U-plane frames.
+    uint64_t symbolOffset(uint64_t symbol) const
+    {
+        return symbol * symbolBytes + controlSlotsBefore(symbol) * controlSlotBytes;
+    }
+
+    // Largest number of bytes a unit of `unitSymbols` symbols can span, C-plane frames included
+    uint64_t maxUnitBytes(uint64_t unitSymbols) const
+    {
+        return unitSymbols * symbolBytes + ((unitSymbols + controlAdvance) / SYMBOL_PER_SLOT + 1) * controlSlotBytes;
+    }
+
+    // Offset in the stream of the frame of a packet (or of the end of the stream for totalPackets). Within a
+    // symbol the packets of flow 0 come first, then those of flow 1, and so on.
+    uint64_t packetOffset(uint64_t packetNo) const
+    {
+        uint64_t symbol = packetNo / packetsPERsymbol;
+        uint64_t inSymbol = packetNo % packetsPERsymbol;
+        return symbol * symbolBytes + controlSlotsBefore(symbol + 1) * controlSlotBytes + (inSymbol / sectionsPERflow) * flowSymbolBytes +
+               sections[inSymbol % sectionsPERflow].frameOffset;
+    }
+
+    // Build the C-plane message of `flow` for the slot `slotNo` of the stream in the frame starting at `frame`
+    void buildControl(uint64_t flow, uint64_t slotNo, uint8_t *frame) const
+    {
+        uint64_t subframeCount = slotNo / slotsPerFrame;
+
+        controlHeaderFields fields;
+        fields.frameId = static_cast<uint8_t>((subframeCount / SUBFRAME_PER_FRAME) % 256);
+        fields.subframeId = static_cast<uint8_t>(subframeCount % SUBFRAME_PER_FRAME);
+        fields.slotId = static_cast<uint8_t>(slotNo % slotsPerFrame);
+        fields.udCompHdr = udCompHdr;
+        fields.ecpriSeqid = static_cast<uint16_t>(slotNo % 256);
+        fields.eaxcId = flows[flow].eaxcId;
+        builders[flow].finishControlFrame(frame, fields, controlSections);
+    }
+
+    // Build the packets of `flow` in the symbols [firstSymbol, lastSymbol) at their place in the frames of
+    // those symbols, which start at `destination`, along with the C-plane messages of the flow sent there
+    void buildPackets(uint64_t flow, uint64_t firstSymbol, uint64_t lastSymbol, uint8_t *destination, payloadCrcCache &crcCache) const
+    {
+        (this->*buildKernel)(flow, firstSymbol, lastSymbol, destination, crcCache);
+    }
+
+    // buildPackets for a numerology (slots per subframe) and a number of packets per symbol and flow known
+    // at compile time; 0 stands for the runtime value
+    template <uint64_t SlotsPerFrame, uint64_t PacketsPerSymbol>
+    void buildPacketsFor(uint64_t flow, uint64_t firstSymbol, uint64_t lastSymbol, uint8_t *destination, payloadCrcCache &crcCache) const
+    {
+        const uint64_t perSymbol = PacketsPerSymbol ? PacketsPerSymbol : sectionsPERflow;
+        const uint64_t firstControl = controlSlotsBefore(firstSymbol);
+        scopedStage timer{stage::frameAssembly, (lastSymbol - firstSymbol) * flowSymbolBytes +
+                                                    (controlSlotsBefore(lastSymbol) - firstControl) * controlFrameBytes};
+        const frameBuilder &builder = builders[flow];
+        const streamFlow &source = flows[flow];
+        vector<int8_t> slice(compressor.enabled() ? iqSamplesPERpacket : 0); // Raw samples waiting for compression
+        for (uint64_t symbol = firstSymbol; symbol < lastSymbol; symbol++)
+        {
+            // C-plane messages sent at this symbol come first
+            uint64_t controlBefore = controlSlotsBefore(symbol);
+            uint64_t controlAfter = controlSlotsBefore(symbol + 1);
+            uint8_t *symbolStart = destination + (symbol - firstSymbol) * symbolBytes + (controlBefore - firstControl) * controlSlotBytes;
+            for (uint64_t slotNo = controlBefore; slotNo < controlAfter; slotNo++)
+            {
+                buildControl(flow, slotNo, symbolStart + (slotNo - controlBefore) * controlSlotBytes + flow * controlFrameBytes);
+            }
+
+            uint8_t *symbolFrames = symbolStart + (controlAfter - controlBefore) * controlSlotBytes + flow * flowSymbolBytes;
+            for (uint64_t i = 0; i < perSymbol; i++)
+            {
+                uint64_t packetNo = symbol * perSymbol + i; // Index among the packets of the flow
+                packetHeaderFields fields = fieldsOf<SlotsPerFrame, PacketsPerSymbol>(flow, packetNo);
+                const plannedSection &section = sections[i];
+                uint64_t samples = 2 * RE_PER_RB * section.numPrbu;
+                uint8_t *frame = symbolFrames + section.frameOffset;
+                uint8_t *payload = builder.iqPosition(frame);
+
+                if (templatesEnabled)
+                {
+                    // Hot path for fixed payloads: copy the pre-built slice, then stamp headers and FCS
+                    const frameTemplateCache &templates = frameTemplates[source.source];
+                    uint64_t index = templates.indexOf(packetNo);
+                    {
+                        scopedStage fetch{stage::payloadFetch, payloadBytesPERpacket};
+                        memcpy(payload, templates.body(index), payloadBytesPERpacket);
+                    }
+                    builder.finishFrame(frame, fields, payloadBytesPERpacket, templates.crc(index));
+                }
+                else if (payloadType == "fixed")
+                {
+                    // Copy the samples of this packet straight to their place in the frame, or to the side first
+                    // when they still have to be compressed
+                    const vector<int8_t> &samplesOfFlow = iqSamples[source.source];
+                    uint64_t sliceOffset = (symbol * symbolSamples + section.sampleOffset) % samplesOfFlow.size();
+                    {
+                        scopedStage fetch{stage::payloadFetch, section.payloadBytes};
+                        if (compressor.enabled())
+                        {
+                            copyIqSlice(samplesOfFlow, reinterpret_cast<uint8_t *>(slice.data()), sliceOffset, samples);
+                            compressor.encode(slice.data(), section.numPrbu, payload);
+                        }
+                        else
+                        {
+                            copyIqSlice(samplesOfFlow, payload, sliceOffset, samples);
+                        }
+                    }
+
+                    // Stamp the ORAN, eCPRI and Ethernet headers around the samples, then FCS and IFGs.
+                    // With a fixed payload the slice starting at this offset repeats, so its CRC is cached.
+                    uint32_t sliceCrc = crcCache.get(source.source, sliceOffset, payload, section.payloadBytes);
+                    builder.finishFrame(frame, fields, section.payloadBytes, &sliceCrc);
+                }
+                else
+                {
+                    // Random samples are generated straight into the frame from (flow seed, packetNo)
+                    {
+                        scopedStage fetch{stage::payloadFetch, section.payloadBytes};
+                        if (compressor.enabled())
+                        {
+                            source.random.fill(packetNo, reinterpret_cast<uint8_t *>(slice.data()), samples);
+                            compressor.encode(slice.data(), section.numPrbu, payload);
+                        }
+                        else
+                        {
+                            source.random.fill(packetNo, payload, samples);
+                        }
+                    }
+                    builder.finishFrame(frame, fields, section.payloadBytes);
+                }
+            }
+        }
+    }
+
+    // Build the work units on `threads` worker threads. A work item is one flow of one unit of symbols, so
+    // the flows of a unit are built in parallel. Workers take the next unbuilt item from a shared counter,
+    // so faster threads simply take more items. With a direct window every item is built at its final
+    // offset; otherwise units go through a ring of 2 * threads buffers, a unit is ready once all its flows
+    // are built, and this thread hands the units to the sink in stream order. An exception in a worker or
+    // in the sink stops every thread; it is rethrown here once they are joined.
+    void generateParallel(streamSink &sink, uint8_t *window, uint64_t unitSymbols, uint64_t units, uint64_t unitBytes)
+    {
+        const uint64_t totalSymbols = totalPackets / packetsPERsymbol;
+        const uint64_t items = units * flowsNo;
+        const uint64_t ringSize = window ? 0 : 2 * threads;
+        vector<vector<uint8_t>> ring(ringSize, vector<uint8_t>(unitBytes));
+        vector<uint64_t> flowsLeft(ringSize, flowsNo); // Flows of the unit in each slot still being built
+
+        atomic<uint64_t> nextItem{0};
+        uint64_t delivered{0}; // Units already handed to the sink (guarded by ringMutex)
+        bool stopped{false};   // Set when a thread failed (guarded by ringMutex)
+        exception_ptr failure; // First worker exception (guarded by ringMutex)
+        mutex ringMutex;
+        condition_variable ringChanged;
+
+        // Leave no item to take and wake every waiting thread
+        auto stop = [&]()
+        {
+            nextItem = items;
+            stopped = true;
+            ringChanged.notify_all();
+        };
+
+        auto worker = [&]()
+        {
+            payloadCrcCache localCache; // The shared cache is not thread safe, so each worker keeps its own
+            try
+            {
+                for (uint64_t item = nextItem++; item < items; item = nextItem++)
+                {
+                    uint64_t unit = item / flowsNo;
+                    uint64_t flow = item % flowsNo;
+                    uint64_t first = unit * unitSymbols;
+                    uint64_t last = min(first + unitSymbols, totalSymbols);
+
+                    if (window)
+                    {
+                        buildPackets(flow, first, last, window + symbolOffset(first), localCache);
+                        continue;
+                    }
+
+                    // Wait until the ring slot of this unit has been handed to the sink
+                    uint64_t slot = unit % ringSize;
+                    {
+                        unique_lock<mutex> lock(ringMutex);
+                        ringChanged.wait(lock, [&]
+                                         { return unit < delivered + ringSize || stopped; });
+                        if (stopped)
+                        {
+                            break;
+                        }
+                    }
+                    buildPackets(flow, first, last, ring[slot].data(), localCache);
+                    bool unitDone;
+                    {
+                        lock_guard<mutex> lock(ringMutex);
+                        unitDone = --flowsLeft[slot] == 0;
+                    }
+                    if (unitDone)
+                    {
+                        ringChanged.notify_all();
+                    }
+                }
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(ringMutex);
+                if (!failure)
+                {
+                    failure = current_exception();
+                }
+                stop();
+            }
+
+            lock_guard<mutex> lock(ringMutex);
+            iqCrcCache.mergeCounters(localCache);
+        };
+
+        vector<thread> workers;
+        auto joinWorkers = [&]()
+        {
+            for (auto &t : workers)
+            {
+                t.join();
+            }
+        };
+        for (unsigned i = 0; i < threads; i++)
+        {
+            workers.emplace_back(worker);
+        }
+
+        if (window)
+        {
+            joinWorkers();
+            if (failure)
+            {
+                rethrow_exception(failure);
+            }
+            generatedBytes += symbolOffset(totalSymbols);
+            return;
+        }
+
+        // Hand the units to the sink in stream order as soon as all their flows are built
+        try
+        {
+            for (uint64_t unit = 0; unit < units; unit++)
+            {
+                uint64_t slot = unit % ringSize;
+                uint64_t bytes = symbolOffset(min(unit * unitSymbols + unitSymbols, totalSymbols)) - symbolOffset(unit * unitSymbols);
+                {
+                    unique_lock<mutex> lock(ringMutex);
+                    ringChanged.wait(lock, [&]
+                                     { return flowsLeft[slot] == 0 || stopped; });
+                    if (stopped)
+                    {
+                        break;
+                    }
+                }
+                {
+                    scopedStage timer{stage::streamAppend, bytes};
+                    sink.write(ring[slot].data(), bytes);
+                }
+                generatedBytes += bytes;
+                {
+                    lock_guard<mutex> lock(ringMutex);
+                    flowsLeft[slot] = flowsNo;
+                    delivered++;
+                }
+                ringChanged.notify_all();
+            }
+        }
+        catch (...)
+        {
+            {
+                lock_guard<mutex> lock(ringMutex);
+                stop();
+            }
+            joinWorkers();
+            throw;
+        }
+
+        joinWorkers();
+        if (failure)
+        {
+            rethrow_exception(failure);
+        }
+    }
+
+    // Pick the buildPacketsFor specialization of this configuration: SCS 15/30/60/120 kHz, and the packets
+    // per symbol and flow of the usual NrbPerPacket values (273 in one packet, 55, 30 and 10 PRBs per packet)
+    template <uint64_t SlotsPerFrame>
+    buildFunction selectBuildKernel() const
+    {
+        switch (sectionsPERflow)
+        {
+        case 1:
+            return &packetStreaming::buildPacketsFor<SlotsPerFrame, 1>;
+        case 5:
+            return &packetStreaming::buildPacketsFor<SlotsPerFrame, 5>;
+        case 10:
+            return &packetStreaming::buildPacketsFor<SlotsPerFrame, 10>;
+        case 28:
+            return &packetStreaming::buildPacketsFor<SlotsPerFrame, 28>;
+        default:
+            return &packetStreaming::buildPacketsFor<SlotsPerFrame, 0>;
+        }
+    }
+
+    buildFunction selectBuildKernel() const
+    {
+        switch (slotsPerFrame)
+        {
+        case 1:
+            return selectBuildKernel<1>();
+        case 2:
+            return selectBuildKernel<2>();
+        case 4:
+            return selectBuildKernel<4>();
+        case 8:
+            return selectBuildKernel<8>();
+        default:
+            return &packetStreaming::buildPacketsFor<0, 0>;
+        }
+    }
+
+    // Copy `count` IQ samples of `samples` starting at `offset` into `destination`, wrapping around their end
+    static void copyIqSlice(const vector<int8_t> &samples, uint8_t *destination, uint64_t offset, uint64_t count)
+    {
+        while (count > 0)
+        {
+            uint64_t run = min(count, static_cast<uint64_t>(samples.size()) - offset);
+            memcpy(destination, samples.data() + offset, run);
+            destination += run;
+            count -= run;
+            offset = 0;
+        }
+    }
+
+    // Plan the packets of a symbol. When NrbPerPacket fits in Eth.MaxPacketSize the symbol keeps its
+    // ceil(MaxNrb / NrbPerPacket) packets of NrbPerPacket PRBs each. Otherwise the MaxNrb PRBs of the symbol
+    // are spread as evenly as possible over the fewest packets that fit, instead of failing.
+    void planSections()
+    {
+        frameBuilder builder{destAddress, sourceAddress, minNumOfIFGsPerPacket, compressor.payloadSize(nrbPerPacket), flows[0].tag};
+        auto fits = [&](uint64_t prbs)
+        { return builder.frameSize(compressor.payloadSize(prbs)) <= maxPacketSize; };
+
+        vector<uint16_t> sizes;
+        if (fits(nrbPerPacket))
+        {
+            sizes.assign(static_cast<size_t>(ceil(static_cast<double>(maxNrb) / nrbPerPacket)), nrbPerPacket);
+        }
+        else
+        {
+            // Largest PRB count that fits (frame sizes grow with the PRB count)
+            uint64_t low = 0, high = nrbPerPacket;
+            while (high - low > 1)
+            {
+                uint64_t middle = (low + high) / 2;
+                (fits(middle) ? low : high) = middle;
+            }
+            if (low == 0)
+            {
+                throw runtime_error("Ethernet Frame exceeds the maximum allowed size of " + to_string(maxPacketSize) + " bytes even with 1 PRB per packet.");
+            }
+
+            uint64_t packets = (maxNrb + low - 1) / low;
+            for (uint64_t i = 0; i < packets; i++)
+            {
+                sizes.push_back(static_cast<uint16_t>(maxNrb / packets + (i < maxNrb % packets)));
+            }
+            fragmented = true;
+        }
+
+        sections.clear();
+        flowSymbolBytes = 0;
+        symbolSamples = 0;
+        uint16_t startPrbu = 0;
+        for (uint16_t prbs : sizes)
+        {
+            plannedSection section;
+            section.startPrbu = startPrbu;
+            section.numPrbu = prbs;
+            section.sampleOffset = symbolSamples;
+            section.payloadBytes = compressor.payloadSize(prbs);
+            section.frameOffset = flowSymbolBytes;
+            sections.push_back(section);
+
+            startPrbu += prbs;
+            symbolSamples += 2 * RE_PER_RB * prbs;
+            flowSymbolBytes += builder.frameSize(section.payloadBytes);
+        }
+        uniformSections = sizes.front() == sizes.back();
+    }
+
+    // Helper function to handle default Resource Blocks
+    uint16_t fixRB(uint16_t RB)
+    {
+        if (RB == 0)
+        {
+            return uint16_t(273); // Maximum number of RBs if no value provided
+        }
+        else
+        {
+            return RB;
+        }
+    }
+};
+
+// Function to export the generated packet stream to a text file, optionally on several threads
+void writePacketStreamToFile(const vector<uint8_t> &fullPacketStream, const string &fileName, unsigned threads = 1)
+{
+    scopedStage timer{stage::exportStream, fullPacketStream.size()};
+    cout << "========= Start Exporting the Stream =========" << endl;
+
+#ifndef _WIN32
+    if (threads > 1)
+    {
+        // Preallocate the text file and let every thread write its slice at its final offset
+        int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            throw runtime_error("Failed to open output file " + fileName);
+        }
+
+        cout << " Exporting the stream to .\\" << fileName << " on " << threads << " threads" << endl;
+        preallocateFile(fd, hexEncoder::encodedSize(fullPacketStream.size(), 0));
+        pwriteHexAt(fd, fullPacketStream.data(), fullPacketStream.size(), 0, threads);
+        close(fd);
+
+        cout << "========= Done Exporting the Stream =========" << endl;
+        return;
+    }
+#else
+    (void)threads; // Positional writes are POSIX only, parseCommandLine rejects --export-threads elsewhere
+#endif
+
+    // Create and open a text file to store the generated packet stream
+    ofstream MyFile(fileName);
+
+    cout << " Exporting the stream to .\\" << fileName << endl;
+
+    // Counter to insert a line break after every 4 bytes
+    uint8_t counter{0};
+
+    // Write each byte of the fullPacketStream as a 2-digit hex value, 4 bytes per line
+    writeHexLines(MyFile, fullPacketStream.data(), fullPacketStream.size(), counter);
+
+    // Close the file after writing is done
+    MyFile.close();
+    if (!MyFile)
+    {
+        throw runtime_error("Failed to write the output file");
+    }
+    cout << "========= Done Exporting the Stream =========" << endl;
+}
+
+// Stream buffer that drops everything, used to keep the generators quiet while they are timed
+class nullBuffer : public streambuf
+{
+protected:
+    int overflow(int c) override
+    {
+        return c;
+    }
+};
+
+// Micro benchmarks of every stage in isolation and macro benchmarks of the whole pipeline over a grid of
+// configurations. Each case runs repeatedly until it has taken at least `minSeconds`, then reports
+// ns/packet, packets/s and the effective rate in Gbps of the bytes it produced. The results are printed
+// as a table and can be written to a JSON file to track them over time.
+class benchmarkSuite
+{
+private:
+    struct result
+    {
+        string stage;
+        string parameters; // JSON object
+        uint64_t iterations;
+        uint64_t packets;
+        uint64_t bytes;
+        double seconds;
+    };
+
+    double minSeconds;
+    vector<result> results;
+    volatile uint64_t blackHole{0}; // Results of the timed code, so that it cannot be optimized away
+
+    // Run `body` (which handles `packets` packets and produces `bytes` bytes) until minSeconds have passed
+    void measure(const string &stage, const string &parameters, uint64_t packets, uint64_t bytes, const function<void()> &body)
+    {
+        body(); // Warm up caches, tables and lazy kernels
+
+        uint64_t iterations = 1;
+        double seconds = 0;
+        while (true)
+        {
+            auto start = chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; i++)
+            {
+                body();
+            }
+            seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (seconds >= minSeconds || iterations >= (1ULL << 40))
+            {
+                break;
+            }
+            iterations *= seconds > 0 ? max<uint64_t>(2, min<uint64_t>(100, static_cast<uint64_t>(1.5 * minSeconds / seconds))) : 100;
+        }
+
+        result entry{stage, parameters, iterations, packets * iterations, bytes * iterations, seconds};
+        results.push_back(entry);
+
+        ostringstream line;
+        line << left << setw(24) << stage << setw(76) << parameters << right << fixed << setprecision(1)
+             << setw(10) << nsPerPacket(entry) << " ns/pkt" << setw(14) << entry.packets / seconds << " pkt/s"
+             << setprecision(2) << setw(9) << gbps(entry) << " Gbps";
+        cout << line.str() << endl;
+    }
+
+    static double nsPerPacket(const result &entry) { return 1e9 * entry.seconds / entry.packets; }
+    static double gbps(const result &entry) { return 8.0 * entry.bytes / entry.seconds / 1e9; }
+
+public:
+    benchmarkSuite(double MinSeconds = 0.2) : minSeconds(MinSeconds)
+    {
+    }
+
+    // Every stage on its own, over a batch of packets of `nrb` PRBs
+    void runMicro(uint16_t nrb)
+    {
+        const uint64_t batch = 1024;
+        const uint64_t samples = 2 * RE_PER_RB * nrb;
+        array<uint8_t, 6> dest{0x01, 0x01, 0x01, 0x01, 0x01, 0x01};
+        array<uint8_t, 6> src{0x33, 0x33, 0x33, 0x33, 0x33, 0x33};
+        frameBuilder builder{dest, src, 12, samples};
+        uint64_t frameBytes = builder.frameSize(samples);
+        string parameters = "{\"nrb_per_packet\":" + to_string(nrb) + ",\"frame_bytes\":" + to_string(frameBytes) + "}";
+
+        vector<uint8_t> frames(batch * frameBytes);
+        randomIqGenerator random{1};
+        for (uint64_t p = 0; p < batch; p++)
+        {
+            random.fill(p, builder.iqPosition(frames.data() + p * frameBytes), samples);
+        }
+        auto fieldsOf = [&](uint64_t p)
+        {
+            return packetHeaderFields{uint8_t(p >> 8), uint8_t(p % 10), uint8_t(p % 2), uint8_t(p % 14),
+                                      uint16_t((p % 9) * nrb), nrb, uint16_t(p % 255), 0};
+        };
+
+        measure("crc32", "{\"implementation\":" + jsonString(crc32Engine::name()) + ",\"bytes\":" + to_string(frameBytes) + "}", batch, batch * frameBytes, [&]
+                {
+                    uint32_t crc = 0;
+                    for (uint64_t p = 0; p < batch; p++)
+                    {
+                        crc ^= crc32Engine::compute(frames.data() + p * frameBytes, frameBytes);
+                    }
+                    blackHole = blackHole + crc; });
+
+        measure("OranPacket", parameters, batch, batch * OranPacket::headerSize, [&]
+                {
+                    for (uint64_t p = 0; p < batch; p++)
+                    {
+                        packetHeaderFields f = fieldsOf(p);
+                        OranPacket{f.frameId, f.subframeId, f.slotId, f.symbolId, f.startPrbu, f.numPrbu}.writeHeader(frames.data() + p * frameBytes + 30);
+                    }
+                    blackHole = blackHole + frames[30]; });
+
+        measure("EcpriPacket", parameters, batch, batch * EcpriPacket::headerSize, [&]
+                {
+                    for (uint64_t p = 0; p < batch; p++)
+                    {
+                        EcpriPacket{uint16_t(p % 255), uint16_t(samples + OranPacket::headerSize)}.writeHeader(frames.data() + p * frameBytes + 22);
+                    }
+                    blackHole = blackHole + frames[22]; });
 
-    // Variables for important calculations
-    uint64_t totalTransmisson;
-    double totalFrames;
-    uint64_t packetsPERsymbol;
-    uint64_t packetsPERslot;
-    uint64_t packetsPERsubframe;
-    uint64_t packetsPERframe;
-    uint64_t slotsPerFrame;
-    uint64_t totalPackets;
-    uint64_t iqSamplesPERpacket;
-    uint64_t totalSamples;
-    int64_t IFGsNo;
-    ;
+        EthernetPacket ethernet{dest, src, 12};
+        uint64_t ethernetPayload = EcpriPacket::headerSize + OranPacket::headerSize + samples;
+        measure("EthernetPacket", parameters, batch, batch * frameBytes, [&]
+                {
+                    for (uint64_t p = 0; p < batch; p++)
+                    {
+                        uint8_t *frame = frames.data() + p * frameBytes;
+                        ethernet.writeHeader(frame, static_cast<uint16_t>(ethernetPayload));
+                        ethernet.writeTrailer(frame, ethernetPayload);
+                    }
+                    blackHole = blackHole + frames[frameBytes - 1]; });
+
+        measure("frameBuilder", parameters, batch, batch * frameBytes, [&]
+                {
+                    for (uint64_t p = 0; p < batch; p++)
+                    {
+                        builder.finishFrame(frames.data() + p * frameBytes, fieldsOf(p), samples);
+                    }
+                    blackHole = blackHole + frames[frameBytes - 1]; });
+
+        measure("randomIqGenerator", parameters, batch, batch * samples, [&]
+                {
+                    for (uint64_t p = 0; p < batch; p++)
+                    {
+                        random.fill(p, builder.iqPosition(frames.data() + p * frameBytes), samples);
+                    }
+                    blackHole = blackHole + *builder.iqPosition(frames.data()); });
+
+        vector<uint8_t> compressed(bfpCompressor{9}.payloadSize(nrb));
+        measure("bfpCompressor", "{\"nrb_per_packet\":" + to_string(nrb) + ",\"iq_width\":9}", batch, batch * compressed.size(), [&]
+                {
+                    bfpCompressor compressor{9};
+                    for (uint64_t p = 0; p < batch; p++)
+                    {
+                        compressor.encode(reinterpret_cast<const int8_t *>(builder.iqPosition(frames.data() + p * frameBytes)), nrb, compressed.data());
+                    }
+                    blackHole = blackHole + compressed[2]; });
+
+        vector<char> text(hexEncoder::encodedSize(frames.size(), 0));
+        measure("hexEncoder", parameters, batch, text.size(), [&]
+                {
+                    uint8_t counter = 0;
+                    hexEncoder::encode(frames.data(), frames.size(), counter, text.data());
+                    blackHole = blackHole + text[0]; });
+    }
+
+    // The whole generator for every combination of the grid, built from `configFile` with overrides
+    void runMacro(const string &configFile, const vector<uint64_t> &lineRates, const vector<uint16_t> &nrbs, unsigned threads)
+    {
+        nullBuffer discard;
+        for (const string payload : {"fixed", "random"})
+        {
+            for (uint16_t nrb : nrbs)
+            {
+                for (uint64_t lineRate : lineRates)
+                {
+                    map<string, string> overrides{{"Eth.LineRate", to_string(lineRate)},
+                                                  {"Oran.NrbPerPacket", to_string(nrb)},
+                                                  {"Oran.PayloadType", payload},
+                                                  {"Oran.Seed", "1"}};
+                    streambuf *console = cout.rdbuf(&discard);
+                    try
+                    {
+                        parseConfigurations configuration(configFile, overrides);
+                        packetStreaming generator{configuration};
+                        generator.setThreads(threads);
+                        nullSink sink;
+                        generator.generateStream(sink); // Learn the packet and byte counts
+                        string parameters = "{\"line_rate_gbps\":" + to_string(lineRate) + ",\"nrb_per_packet\":" + to_string(nrb) +
+                                            ",\"payload\":" + jsonString(payload) + ",\"threads\":" + to_string(threads) + "}";
+                        uint64_t packets = generator.getTotalPackets();
+                        uint64_t bytes = generator.getGeneratedBytes();
+                        cout.rdbuf(console);
+                        measure("generateStream", parameters, packets, bytes, [&]
+                                {
+                                    streambuf *saved = cout.rdbuf(&discard);
+                                    generator.generateStream(sink);
+                                    cout.rdbuf(saved); });
+                    }
+                    catch (const exception &error)
+                    {
+                        cout.rdbuf(console);
+                        cout << "generateStream skipped for line rate " << lineRate << ", NrbPerPacket " << nrb << ": " << error.what() << endl;
+                    }
+                }
+            }
+        }
+
+        // Hex export of the stream of the first line rate, to a scratch file
+        streambuf *console = cout.rdbuf(&discard);
+        parseConfigurations configuration(configFile, {{"Eth.LineRate", to_string(lineRates.front())}});
+        packetStreaming generator{configuration};
+        vector<uint8_t> stream = generator.generateStream();
+        cout.rdbuf(console);
+        const string scratch = "benchmark_export.tmp";
+        string parameters = "{\"line_rate_gbps\":" + to_string(lineRates.front()) + ",\"bytes\":" + to_string(stream.size()) + "}";
+        measure("writePacketStreamToFile", parameters, generator.getTotalPackets(), stream.size(), [&]
+                {
+                    streambuf *saved = cout.rdbuf(&discard);
+                    writePacketStreamToFile(stream, scratch);
+                    cout.rdbuf(saved); });
+        remove(scratch.c_str());
+    }
+
+    // Write every result as one JSON document
+    void writeJson(const string &fileName) const
+    {
+        ofstream file(fileName);
+        if (!file)
+        {
+            throw runtime_error("Failed to open benchmark output file " + fileName);
+        }
+        file << "{\n  \"crc32\": " << jsonString(crc32Engine::name()) << ",\n  \"hardware_threads\": " << thread::hardware_concurrency()
+             << ",\n  \"results\": [\n";
+        file << setprecision(10);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const result &entry = results[i];
+            file << "    {\"stage\": " << jsonString(entry.stage) << ", \"parameters\": " << entry.parameters
+                 << ", \"iterations\": " << entry.iterations << ", \"packets\": " << entry.packets
+                 << ", \"seconds\": " << entry.seconds
+                 << ", \"bytes\": " << entry.bytes << ", \"ns_per_packet\": " << nsPerPacket(entry)
+                 << ", \"packets_per_second\": " << entry.packets / entry.seconds << ", \"gbps\": " << gbps(entry) << "}"
+                 << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        file << "  ]\n}\n";
+        cout << "Benchmark results written to .\\" << fileName << endl;
+    }
+};
+
+// Checks of the optimized kernels against straightforward reference versions, run with --self-test. Each
+// check prints its number of cases and mismatches; run() returns false when any check failed.
+class selfTest
+{
+private:
+    unsigned failures{0};
+
+    void report(const string &name, uint64_t cases, uint64_t mismatches)
+    {
+        cout << left << setw(44) << name << right << setw(10) << cases << " cases, " << mismatches << " mismatches  "
+             << (mismatches ? "FAILED" : "passed") << endl;
+        failures += mismatches > 0;
+    }
+
+    // The bitwise CRC-32 loop of the original EthFrame::crc32, on a running register
+    static uint32_t bitwiseCrc(uint32_t crc, const uint8_t *data, uint64_t length)
+    {
+        while (length--)
+        {
+            crc ^= *data++;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+            }
+        }
+        return crc;
+    }
+
+    // Every CRC path against the bitwise loop: lengths 0..maxLength at 17 start alignments, updates split at
+    // every point of a few lengths, and combine() of the two halves of each split
+    void crc()
+    {
+        const uint64_t maxLength = 4096;
+        const uint64_t alignments = 17;
+        mt19937_64 random(1);
+        vector<uint8_t> buffer(maxLength + alignments);
+        for (uint8_t &byte : buffer)
+        {
+            byte = static_cast<uint8_t>(random());
+        }
+
+        for (const crc32Engine::implementationEntry &engine : crc32Engine::available())
+        {
+            uint64_t cases = 0, mismatches = 0;
+            for (uint64_t alignment = 0; alignment < alignments; alignment++)
+            {
+                const uint8_t *data = buffer.data() + alignment;
+                uint32_t reference = 0xFFFFFFFF; // Grows one byte per length
+                for (uint64_t length = 0; length <= maxLength; length++)
+                {
+                    mismatches += engine.update(0xFFFFFFFF, data, length) != reference;
+                    cases++;
+                    reference = bitwiseCrc(reference, data + length, 1);
+                }
+            }
+            report(string("crc32 ") + engine.name + " update", cases, mismatches);
+
+            cases = mismatches = 0;
+            for (uint64_t length : {0, 1, 15, 16, 63, 64, 65, 127, 300, 1500, 4096})
+            {
+                const uint8_t *data = buffer.data() + length % alignments;
+                uint32_t reference = bitwiseCrc(0xFFFFFFFF, data, length);
+                for (uint64_t split = 0; split <= length; split++)
+                {
+                    mismatches += engine.update(engine.update(0xFFFFFFFF, data, split), data + split, length - split) != reference;
+                    cases++;
+                }
+            }
+            report(string("crc32 ") + engine.name + " split update", cases, mismatches);
+        }
+
+        uint64_t cases = 0, mismatches = 0;
+        for (uint64_t alignment = 0; alignment < alignments; alignment++)
+        {
+            const uint8_t *data = buffer.data() + alignment;
+            uint32_t reference = 0xFFFFFFFF;
+            for (uint64_t length = 0; length <= maxLength; length++)
+            {
+                mismatches += crc32Engine::compute(data, length) != (reference ^ 0xFFFFFFFF);
+                cases++;
+                reference = bitwiseCrc(reference, data + length, 1);
+            }
+        }
+        report(string("crc32 compute (") + crc32Engine::name() + ")", cases, mismatches);
+
+        cases = mismatches = 0;
+        for (uint64_t length : {0, 1, 7, 64, 100, 1500, 4096})
+        {
+            const uint8_t *data = buffer.data() + length % alignments;
+            uint32_t whole = bitwiseCrc(0xFFFFFFFF, data, length) ^ 0xFFFFFFFF;
+            for (uint64_t split = 0; split <= length; split++)
+            {
+                uint32_t crcA = bitwiseCrc(0xFFFFFFFF, data, split) ^ 0xFFFFFFFF;
+                uint32_t crcB = bitwiseCrc(0xFFFFFFFF, data + split, length - split) ^ 0xFFFFFFFF;
+                mismatches += crc32Engine::combine(crcA, crcB, length - split) != whole;
+                mismatches += crc32Engine::combineWithFactor(crcA, crcB, crc32Engine::shiftFactor(length - split)) != whole;
+                cases += 2;
+            }
+        }
+        report("crc32 combine / combineWithFactor", cases, mismatches);
+    }
+
+    // Philox4x32-10 against the Random123 known-answer vectors, and fill() against the scalar blocks for
+    // several seeds, packets and lengths. The vector kernel always uses a zero second counter word, so of
+    // the known answers it is checked on the all-zero one (block 0 of packet 0 under seed 0).
+    void philox()
+    {
+        struct knownAnswer
+        {
+            array<uint32_t, 4> counter;
+            uint32_t key0, key1;
+            array<uint32_t, 4> expected;
+        };
+        const knownAnswer answers[] = {
+            {{0, 0, 0, 0}, 0, 0, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+            {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, 0xffffffff, 0xffffffff, {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+            {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, 0xa4093822, 0x299f31d0, {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+        };
+        uint64_t mismatches = 0;
+        for (const knownAnswer &answer : answers)
+        {
+            mismatches += randomIqGenerator::block(answer.counter, answer.key0, answer.key1) != answer.expected;
+        }
+        report("philox4x32-10 known answers (scalar)", size(answers), mismatches);
+
+        // Eight whole blocks so that the vector kernel, when there is one, writes them
+        array<uint32_t, 32> words;
+        randomIqGenerator(0).fill(0, reinterpret_cast<uint8_t *>(words.data()), sizeof(words));
+        mismatches = !equal(answers[0].expected.begin(), answers[0].expected.end(), words.begin());
+        report(string("philox4x32-10 known answer (") + (randomIqGenerator::vectorized() ? "avx2" : "scalar") + " fill)", 1,
+               mismatches);
+
+        uint64_t cases = 0;
+        mismatches = 0;
+        vector<uint8_t> vectorBytes(4096 + 16), scalarBytes(4096 + 16);
+        for (uint64_t seed : {0ULL, 1ULL, 0x123456789ABCDEFULL, ~0ULL})
+        {
+            randomIqGenerator generator(seed);
+            for (uint64_t packetNo : {0ULL, 1ULL, 77ULL, 0xFFFFFFFFULL, 0x100000000ULL, ~0ULL})
+            {
+                for (uint64_t count = 0; count <= 4096; count += count < 300 ? 1 : 97)
+                {
+                    // Odd destination offsets exercise the unaligned stores
+                    uint64_t offset = count % 16;
+                    fill(vectorBytes.begin(), vectorBytes.end(), 0xA5);
+                    fill(scalarBytes.begin(), scalarBytes.end(), 0xA5);
+                    generator.fill(packetNo, vectorBytes.data() + offset, count);
+                    generator.fillScalar(packetNo, scalarBytes.data() + offset, count);
+                    mismatches += vectorBytes != scalarBytes;
+                    cases++;
+                }
+            }
+        }
+        report("philox4x32-10 fill against scalar blocks", cases, mismatches);
+    }
+
+    // The stringstream parser iqSampleLoader replaced
+    static vector<int8_t> streamParse(const string &text)
+    {
+        vector<int8_t> samples;
+        istringstream file(text);
+        string line;
+        while (getline(file, line))
+        {
+            stringstream ss(line);
+            int num1, num2;
+            if (ss >> num1 >> num2)
+            {
+                samples.push_back(num1);
+                samples.push_back(num2);
+            }
+        }
+        return samples;
+    }
+
+    // iqSampleLoader::parse against the stringstream parser on random texts built from numbers (some out of
+    // range), signs, blanks, carriage returns, letters and empty lines, with and without a final newline.
+    // Then a cache whose sample count disagrees with its size must be ignored, not trusted.
+    void iqParser()
+    {
+        static const char *const tokens[] = {"0", "7", "-3", "+12", "127", "-128", "255", "-129", "1000",
+                                             "2147483647", "2147483648", "-2147483649", "99999999999", "+", "-",
+                                             "+-5", "-+5", "--1", "0x1F", "12abc", "1.5", "a", " ", "  ", "\t",
+                                             "\r", "\v", "\f", "\n", "\n", "\n", "\r\n"};
+        mt19937_64 random(2);
+        uint64_t cases = 0, mismatches = 0;
+        for (int text = 0; text < 20000; text++)
+        {
+            string input;
+            uint64_t pieces = random() % 64;
+            for (uint64_t piece = 0; piece < pieces; piece++)
+            {
+                input += tokens[random() % size(tokens)];
+                if (random() % 2)
+                {
+                    input += ' ';
+                }
+            }
+            mismatches += iqSampleLoader::parse(input.data(), input.size()) != streamParse(input);
+            cases++;
+        }
+        report("iq parse against stringstream parser", cases, mismatches);
+
+        cases = mismatches = 0;
+        filesystem::path textFile = filesystem::temp_directory_path() / ("iq_self_test_" + to_string(random()) + ".txt");
+        {
+            ofstream file(textFile);
+            for (int line = 0; line < 1000; line++)
+            {
+                file << static_cast<int>(random() % 256) - 128 << " " << static_cast<int>(random() % 256) - 128 << "\n";
+            }
+        }
+        string cacheFile = textFile.string() + ".iqbin";
+        vector<int8_t> expected = iqSampleLoader::load(textFile.string(), false);
+        for (uint64_t corruptSamples : {uint64_t(0), uint64_t(1), expected.size() + 1, uint64_t(1) << 62})
+        {
+            iqSampleLoader::load(textFile.string(), true); // Writes a valid cache
+            {
+                fstream cache(cacheFile, ios::in | ios::out | ios::binary);
+                cache.seekp(24); // cacheHeader::samples follows the magic, size and time
+                cache.write(reinterpret_cast<const char *>(&corruptSamples), sizeof(corruptSamples));
+            }
+            mismatches += iqSampleLoader::load(textFile.string(), true) != expected;
+            cases++;
+        }
+        mismatches += iqSampleLoader::load(textFile.string(), true) != expected; // The cache rewritten by the last load
+        cases++;
+        filesystem::remove(cacheFile);
+        filesystem::remove(textFile);
+        report("iq cache with a corrupted sample count", cases, mismatches);
+    }
 
 public:
-    // Constructor to initialize the packetStreaming object with configuration and payload data
-    packetStreaming(const parseConfigurations &configuration)
+    bool run()
     {
-        // Assign configuration values to class members
-        lineRate = static_cast<uint64_t>(configuration.LineRate);
-        captureSize = static_cast<uint64_t>(configuration.CaptureSizeMs);
-        minNumOfIFGsPerPacket = configuration.MinNumOfIFGsPerPacket;
+        cout << "========= Self Test =========" << endl;
+        crc();
+        philox();
+        iqParser();
+        cout << "Self Test: " << (failures ? "FAILED" : "PASSED") << endl;
+        return failures == 0;
+    }
+};
 
-        // Convert configuration addresses and size to byte arrays
-        destAddress = intToArray<uint64_t, 6>(configuration.DestAddress);
-        sourceAddress = intToArray<uint64_t, 6>(configuration.SourceAddress);
+// Runs the generator for every combination of a sweep file in one process. Each line of the sweep file
+// gives the values of one configuration key, either as a comma-separated list ("Oran.SCS = 15, 30") or
+// as an inclusive range with an optional step ("Eth.LineRate = 10..100:10"); they replace the values
+// of the base configuration. Combinations run in parallel, one per worker thread, and share the IQ
+// files loaded once; the CRC tables are built once per process and each worker reuses its chunk and
+// hex buffers from one run to the next. Every combination writes its own output,
+// <stem>_<run><extension>, and a row of the summary table.
+class parameterSweep
+{
+private:
+    struct runResult
+    {
+        uint64_t frames{0};
+        uint64_t bytes{0};
+        int64_t idleBytes{0}; // IFGs filling the capture after the last packet
+        double seconds{0};
+        bool failed{false};
+        string outcome; // Output file, stream CRC or error message
+    };
 
-        scs = static_cast<uint8_t>(configuration.SCS);
-        maxNrb = fixRB(static_cast<uint16_t>(configuration.MaxNrb));
-        nrbPerPacket = fixRB(static_cast<uint16_t>(configuration.NrbPerPacket));
-        payloadType = configuration.PayloadType;
+    string configFile;
+    string outputFile;
+    string format;
+    string sink;
+    vector<pair<string, vector<string>>> axes; // Swept keys in file order, the first one varying slowest
+    uint64_t combinations{1};
 
-        // Important Calculations
-        totalTransmisson = (lineRate * captureSize * 1000000) / 8;
+    map<string, vector<int8_t>> payloads; // IQ files already loaded, shared by every run
+    mutex payloadMutex;
 
-        // Perform important calculations based on configuration
-        totalFrames = static_cast<double>(captureSize / FRAME_PERIOD_MS);
-        packetsPERsymbol = static_cast<uint64_t>(ceil(static_cast<double>(maxNrb) / nrbPerPacket));
-        slotsPerFrame = static_cast<uint64_t>(scs / SCS_PERIODICITY);
-        packetsPERslot = static_cast<uint64_t>(packetsPERsymbol * SYMBOL_PER_SLOT);
-        packetsPERsubframe = static_cast<uint64_t>(packetsPERslot * slotsPerFrame);
-        packetsPERframe = static_cast<uint64_t>(packetsPERsubframe * SUBFRAME_PER_FRAME);
-        totalPackets = static_cast<uint64_t>(packetsPERframe * (captureSize / FRAME_PERIOD_MS) * totalFrames);
-        iqSamplesPERpacket = static_cast<uint64_t>(2 * RE_PER_RB * nrbPerPacket);
-        totalSamples = static_cast<uint64_t>(iqSamplesPERpacket * totalPackets);
+    // Values of one line of the sweep file
+    static vector<string> expand(const string &values)
+    {
+        size_t dots = values.find("..");
+        if (dots == string::npos)
+        {
+            return splitList(values);
+        }
+        size_t colon = values.find(':', dots);
+        uint64_t first = convertIntoInteger(values.substr(0, dots));
+        uint64_t last = convertIntoInteger(values.substr(dots + 2, colon == string::npos ? string::npos : colon - dots - 2));
+        uint64_t step = colon == string::npos ? 1 : convertIntoInteger(values.substr(colon + 1));
+        if (step == 0 || last < first)
+        {
+            throw runtime_error("Wrong sweep range " + values);
+        }
+        vector<string> expanded;
+        for (uint64_t value = first; value <= last; value += step)
+        {
+            expanded.push_back(to_string(value));
+        }
+        return expanded;
+    }
 
-        // Handle fixed or random payload based on PayloadType
-        if (payloadType == "fixed")
+    // Overrides of the combination `run`
+    map<string, string> combination(uint64_t run) const
+    {
+        map<string, string> overrides;
+        for (size_t axis = axes.size(); axis-- > 0;)
         {
-            iqSamples.insert(iqSamples.end(), configuration.iqSamples.begin(), configuration.iqSamples.end());
+            const vector<string> &values = axes[axis].second;
+            overrides[axes[axis].first] = values[run % values.size()];
+            run /= values.size();
         }
-        else if (payloadType == "random")
+        return overrides;
+    }
+
+    string outputName(uint64_t run) const
+    {
+        size_t dot = outputFile.find_last_of('.');
+        size_t slash = outputFile.find_last_of("/\\");
+        bool hasExtension = dot != string::npos && (slash == string::npos || dot > slash);
+        ostringstream name;
+        name << (hasExtension ? outputFile.substr(0, dot) : outputFile) << "_" << setw(static_cast<int>(to_string(combinations).size()))
+             << setfill('0') << run + 1 << (hasExtension ? outputFile.substr(dot) : "");
+        return name.str();
+    }
+
+    const vector<int8_t> &payload(const string &fileName, bool cache)
+    {
+        lock_guard<mutex> lock(payloadMutex);
+        auto found = payloads.find(fileName);
+        if (found == payloads.end())
+        {
+            found = payloads.emplace(fileName, iqSampleLoader::load(fileName, cache)).first;
+        }
+        return found->second;
+    }
+
+    void runOne(uint64_t run, runResult &result)
+    {
+        // Only the progress and the summary are shown, not the reports of the run
+        nullBuffer discard;
+        ostream quiet(&discard);
+        scopedConsole redirect{quiet};
+        auto start = chrono::steady_clock::now();
+        try
+        {
+            parseConfigurations configuration(configFile, combination(run), false);
+            if (configuration.PayloadType == "fixed")
+            {
+                for (const string &fileName : configuration.PayloadFiles)
+                {
+                    configuration.iqSamples.push_back(payload(fileName, configuration.PayloadCache));
+                }
+            }
+            packetStreaming generator{configuration};
+            string name = outputName(run);
+            result.outcome = name;
+            if (sink == "hash")
+            {
+                hashSink hash;
+                generator.generateStream(hash);
+                ostringstream crc;
+                crc << "crc32 0x" << hex << setw(8) << setfill('0') << hash.getCrc();
+                result.outcome = crc.str();
+            }
+            else if (sink == "null")
+            {
+                nullSink discard;
+                generator.generateStream(discard);
+                result.outcome = "ok";
+            }
+            else if (format == "pcapng")
+            {
+                pcapngSink capture{name, configuration.LineRate};
+                generator.generateStream(capture);
+            }
+            else if (format == "rle")
+            {
+                rleSink container{name, configuration.LineRate};
+                generator.generateStream(container);
+            }
+#ifndef _WIN32
+            else if (sink == "mmap")
+            {
+                mmapSink mapped{name, format == "bin"};
+                generator.generateStream(mapped);
+            }
+#endif
+            else
+            {
+                fileSink file{name, format == "bin"};
+                generator.generateStream(file);
+            }
+            result.frames = generator.getTotalPackets() + generator.getControlMessages();
+            result.bytes = generator.getGeneratedBytes();
+            result.idleBytes = generator.getRemainingIfgs();
+        }
+        catch (const exception &error)
+        {
+            result.failed = true;
+            result.outcome = string("error: ") + error.what();
+        }
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    // Short column name of a key ("Eth.LineRate" -> "LineRate")
+    static string column(const string &key)
+    {
+        size_t dot = key.find('.');
+        return dot == string::npos ? key : key.substr(dot + 1);
+    }
+
+public:
+    parameterSweep(const string &sweepFile, const string &ConfigFile, const string &OutputFile, const string &Format, const string &Sink)
+        : configFile(ConfigFile), outputFile(OutputFile), format(Format), sink(Sink)
+    {
+        if (sink != "file" && sink != "mmap" && sink != "null" && sink != "hash")
+        {
+            throw runtime_error("A sweep writes through the file, mmap, null or hash sink");
+        }
+
+        ifstream file(sweepFile);
+        if (!file)
+        {
+            throw runtime_error("Failed to open sweep file " + sweepFile);
+        }
+        string line;
+        while (getline(file, line))
+        {
+            // Same layout as the configuration file: whitespace is ignored and "//" starts a comment
+            line.erase(remove_if(line.begin(), line.end(), [](unsigned char x)
+                                 { return isspace(x); }),
+                       line.end());
+            size_t comment = line.find("//");
+            if (comment != string::npos)
+            {
+                line.erase(comment);
+            }
+            size_t equals = line.find('=');
+            if (line.empty() || equals == string::npos)
+            {
+                continue;
+            }
+            vector<string> values = expand(line.substr(equals + 1));
+            if (values.empty())
+            {
+                throw runtime_error("No values for " + line.substr(0, equals) + " in " + sweepFile);
+            }
+            axes.emplace_back(line.substr(0, equals), values);
+            combinations *= values.size();
+        }
+    }
+
+    // Run every combination on `threads` workers, print the summary table and write it as CSV next to the
+    // outputs. Returns false if a combination failed.
+    bool run(unsigned threads)
+    {
+        cout << "========= Sweeping " << combinations << " combinations on " << threads << " threads =========" << endl;
+        vector<runResult> results(combinations);
+        atomic<uint64_t> nextRun{0};
+        atomic<uint64_t> finished{0};
+        mutex consoleMutex;
+        auto start = chrono::steady_clock::now();
+
+        auto worker = [&]()
+        {
+            for (uint64_t run = nextRun++; run < combinations; run = nextRun++)
+            {
+                runOne(run, results[run]);
+                lock_guard<mutex> lock(consoleMutex);
+                cout << "[" << ++finished << "/" << combinations << "] run " << run + 1 << ": " << results[run].outcome << endl;
+            }
+        };
+        vector<thread> workers;
+        for (unsigned i = 0; i < max(1u, threads); i++)
+        {
+            workers.emplace_back(worker);
+        }
+        for (auto &t : workers)
+        {
+            t.join();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        // Summary table, and the same rows as CSV
+        size_t dot = outputFile.find_last_of('.');
+        size_t slash = outputFile.find_last_of("/\\");
+        string csvName = (dot != string::npos && (slash == string::npos || dot > slash) ? outputFile.substr(0, dot) : outputFile) + "_summary.csv";
+        ofstream csv(csvName);
+        cout << left << setw(6) << "Run";
+        csv << "run";
+        for (const auto &axis : axes)
         {
-            iqSamples.resize(totalSamples);
+            cout << setw(max<size_t>(column(axis.first).size() + 2, 8)) << column(axis.first);
+            csv << "," << axis.first;
+        }
+        cout << right << setw(10) << "Frames" << setw(14) << "Bytes" << setw(8) << "Idle%" << setw(10) << "Seconds" << setw(9) << "Gbps"
+             << "  Result" << endl;
+        csv << ",frames,bytes,idle_percent,seconds,gbps,result" << endl;
 
-            // Random number generator setup
-            random_device rd;  // Seed for the random number engine
-            mt19937 gen(rd()); // Mersenne Twister random number engine
-            uniform_int_distribution<> distrib(-128, 127);
+        bool passed = true;
+        for (uint64_t run = 0; run < combinations; run++)
+        {
+            const runResult &result = results[run];
+            map<string, string> values = combination(run);
+            ostringstream idle, time, rate;
+            idle << fixed << setprecision(1) << (result.bytes ? 100.0 * result.idleBytes / result.bytes : 0.0);
+            time << fixed << setprecision(3) << result.seconds;
+            rate << fixed << setprecision(2) << (result.seconds > 0 ? result.bytes * 8 / result.seconds / 1e9 : 0.0);
 
-            for (int8_t &byte : iqSamples)
+            cout << left << setw(6) << run + 1;
+            csv << run + 1;
+            for (const auto &axis : axes)
             {
-                byte = distrib(gen); // Generate a random number and assign it to the vector
+                cout << setw(max<size_t>(column(axis.first).size() + 2, 8)) << values[axis.first];
+                csv << "," << values[axis.first];
             }
+            cout << right << setw(10) << result.frames << setw(14) << result.bytes << setw(8) << idle.str() << setw(10) << time.str()
+                 << setw(9) << rate.str() << "  " << result.outcome << endl;
+            csv << "," << result.frames << "," << result.bytes << "," << idle.str() << "," << time.str() << "," << rate.str() << ",\""
+                << result.outcome << "\"" << endl;
+            passed = passed && !result.failed;
         }
-        else
-        {
-            throw runtime_error("Wrong PayloadType");
-        }
+        cout << "Swept " << combinations << " combinations in " << seconds << " s, summary written to .\\" << csvName << endl;
+        return passed;
     }
+};
 
-    // Method to construct the full stream of packets and IFGs
-    vector<uint8_t> generateStream()
+// Decodes and checks a captured stream. Frames are located by one sequential walk that jumps from frame
+// to frame through the MAC length field. Their FCS and headers are then checked on several threads, and
+// a last pass in stream order follows every flow (VLAN and eAxC) to check sequence IDs, timing
+// continuity, PRB coverage and that the C-plane message of a slot precedes its U-plane packets.
+// Sequence IDs follow the generator's numbering (packetStreaming::fieldsOf): a U-plane flow starts with
+// two packets numbered 0 and counts modulo 255, a C-plane flow counts modulo 256.
+class streamValidator
+{
+private:
+    enum frameError : uint8_t
     {
-        cout << "========= Start Generating the Stream =========" << endl;
+        fcsError = 1,      // FCS does not match the frame
+        malformedError = 2, // Sizes or header fields that do not fit together
+        prbError = 4        // PRBs that do not match the payload or do not tile the band
+    };
 
-        fullPacket.reserve(totalTransmisson); // Reserve space for full packet stream
+    // A frame of the stream and what its headers say
+    struct frameRecord
+    {
+        uint64_t offset;       // Offset of the preamble in the stream
+        uint32_t length;       // MAC header through FCS
+        uint32_t gap;          // IFG bytes behind the frame
+        uint32_t time;         // Symbols (U-plane) or slots (C-plane) since frame 0, subframe 0, slot 0, symbol 0
+        uint16_t vlanId;       // untagged when 0xFFFF
+        uint16_t eaxcId;
+        uint16_t seqId;
+        uint16_t startPrb;
+        uint16_t numPrb;       // 273 when sent as 0
+        uint8_t messageType;
+        uint8_t errors;        // frameError bits
+    };
 
-        uint8_t frameId{0};
-        uint8_t subframeId{0};
-        uint8_t slotId{0};
-        uint8_t symbolId{0};
-        uint16_t startPrbu{0};
-        uint16_t ecpriSeqid{0};
-        vector<int8_t> data;
-        array<uint8_t, 2> etherSize;
+    // Counters and running state of one flow
+    struct flowStats
+    {
+        uint64_t uplane{0};
+        uint64_t cplane{0};
+        uint64_t bytes{0}; // MAC header through FCS
+        uint64_t fcsErrors{0};
+        uint64_t malformed{0};
+        uint64_t sequenceErrors{0};
+        uint64_t timingErrors{0};
+        uint64_t prbErrors{0};
+        uint64_t lateControl{0}; // U-plane packets of a slot whose C-plane message was not sent before them
+        uint64_t pastMaxNrb{0};  // Packets whose PRBs run past Oran.MaxNrb
 
-        uint64_t sizeOfSamples = iqSamples.size(); // Size of the IQ samples vector
+        uint16_t lastUplaneSeq{0};
+        uint16_t lastControlSeq{0};
+        uint32_t lastSymbol{0};
+        uint32_t lastControlSlot{0};
+        uint32_t prbEnd{0}; // End of the PRBs of the last U-plane packet
+    };
 
-        // Loop over total packets and construct each packet
-        for (uint64_t packetNo = 0; packetNo < totalPackets; packetNo++)
-        {
+    static constexpr uint64_t preambleSize = 8;
+    static constexpr uint8_t preamble[8] = {0xfb, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0xd5};
 
-            // Loop to insert `nrbPerPacket` samples into `data` for the given `packetNo`
-            data.clear();
-            data.reserve(iqSamplesPERpacket);
-            uint64_t index;
-            for (uint64_t i = 0; i < iqSamplesPERpacket; ++i)
-            {
-                // Calculate the index in the IQ sample vector using modulo for wrapping around
-                index = (packetNo * iqSamplesPERpacket + i) % sizeOfSamples;
+    uint64_t minIfg;
+    uint64_t maxNrb;
+    uint64_t slotsPerFrame;
+    uint64_t lineRate;
+    uint64_t expectedBytes;
+    bfpCompressor compressor;
+    uint8_t udCompHdr;
+    unsigned threads;
 
-                // Insert the IQ sample at this index into `data`
-                data.push_back(iqSamples[index]);
+    uint64_t symbolPeriod; // Symbols before frameId wraps around
+    uint64_t slotPeriod;
+
+    // First offset at or after `position` that is not an IFG byte
+    static uint64_t skipIfg(const uint8_t *stream, uint64_t length, uint64_t position)
+    {
+        for (; position + 8 <= length; position += 8)
+        {
+            uint64_t word;
+            memcpy(&word, stream + position, 8);
+            if (word != 0x0707070707070707ULL)
+            {
+                break;
             }
+        }
+        while (position < length && stream[position] == 0x07)
+        {
+            position++;
+        }
+        return position;
+    }
 
-            // Create ORAN packet with header and IQ samples
-            OranPacket oranPacket{frameId, subframeId, slotId, symbolId, startPrbu, nrbPerPacket, data};
-            auto ecpriPayload{oranPacket.getPacket()};
+    // Offset of the next preamble at or after `position` (length when there is none)
+    static uint64_t findPreamble(const uint8_t *stream, uint64_t length, uint64_t position)
+    {
+        while (position + preambleSize <= length)
+        {
+            const void *found = memchr(stream + position, preamble[0], length - position);
+            if (!found)
+            {
+                break;
+            }
+            position = static_cast<const uint8_t *>(found) - stream;
+            if (position + preambleSize <= length && memcmp(stream + position, preamble, preambleSize) == 0)
+            {
+                return position;
+            }
+            position++;
+        }
+        return length;
+    }
 
-            // Create eCPRI packet with ORAN payload
-            EcpriPacket ecpriPacket{ecpriSeqid, ecpriPayload};
-            auto etherPayload{ecpriPacket.getPacket()};
+    // Check the FCS and decode the headers of a frame
+    void inspect(const uint8_t *stream, frameRecord &record) const
+    {
+        const uint8_t *mac = stream + record.offset + preambleSize;
+        bool tagged = mac[12] == 0x81 && mac[13] == 0x00;
+        uint64_t header = tagged ? 18 : 14;
+        record.vlanId = tagged ? static_cast<uint16_t>(vlanTagField::layout::get<vlanTagField::vid>(vlanTagField::layout::load(mac + 12))) : 0xFFFF;
+        record.errors = 0;
 
-            // Convert payload size to etherSize array
-            etherSize = intToArray<uint64_t, 2>(size(etherPayload));
+        uint32_t crc = crc32Engine::update(0xFFFFFFFF, mac, record.length - EthernetPacket::fcsSize) ^ 0xFFFFFFFF;
+        const uint8_t *fcs = mac + record.length - EthernetPacket::fcsSize;
+        if (crc != ((uint32_t(fcs[0]) << 24) | (uint32_t(fcs[1]) << 16) | (uint32_t(fcs[2]) << 8) | fcs[3]))
+        {
+            record.errors |= fcsError;
+        }
 
-            // Create Ethernet packet and retrieve the complete frame
-            EthernetPacket etherPacket{destAddress, sourceAddress, etherSize, etherPayload, minNumOfIFGsPerPacket};
-            auto tempEtherPacket = etherPacket.getPacket();
+        uint64_t macLength = record.length - header - EthernetPacket::fcsSize; // eCPRI message size
+        if (macLength < EcpriPacket::headerSize + 8)
+        {
+            record.errors |= malformedError;
+            return;
+        }
+        using ecpri = ecpriHeader::layout;
+        const uint8_t *message = mac + header;
+        uint64_t ecpriWord = ecpri::load(message);
+        record.messageType = static_cast<uint8_t>(ecpri::get<ecpriHeader::messageType>(ecpriWord));
+        record.eaxcId = static_cast<uint16_t>(ecpri::get<ecpriHeader::pcId>(ecpriWord));
+        record.seqId = static_cast<uint16_t>(ecpri::get<ecpriHeader::seqId>(ecpriWord));
+        if (ecpri::get<ecpriHeader::payloadSize>(ecpriWord) + EcpriPacket::headerSize != macLength)
+        {
+            record.errors |= malformedError;
+        }
+        const uint8_t *body = message + EcpriPacket::headerSize;
+        uint64_t bodyLength = macLength - EcpriPacket::headerSize;
 
-            // Check if the Ethernet frame exceeds maximum allowed size
-            if (size(tempEtherPacket) > maxPacketSize)
+        if (record.messageType == ECPRI_IQ_DATA)
+        {
+            using oran = oranHeader::layout;
+            uint64_t word = oran::load(body);
+            uint64_t subframe = oran::get<oranHeader::subframeId>(word);
+            uint64_t slot = oran::get<oranHeader::slotId>(word);
+            uint64_t symbol = oran::get<oranHeader::symbolId>(word);
+            if (subframe >= SUBFRAME_PER_FRAME || slot >= slotsPerFrame || symbol >= SYMBOL_PER_SLOT)
             {
-                throw runtime_error("Ethernet Frame exceeds the maximum allowed size of " + to_string(maxPacketSize) + " bytes.");
+                record.errors |= malformedError;
             }
-
-            // Add the Ethernet frame to the full packet stream
-            fullPacket.insert(fullPacket.end(), tempEtherPacket.begin(), tempEtherPacket.end());
-
-            // Update IDs and start PRBU for the next packet
-
-            if (packetNo != 0 && (packetNo % packetsPERsymbol == 0))
+            record.time = static_cast<uint32_t>(((oran::get<oranHeader::frameId>(word) * SUBFRAME_PER_FRAME + subframe) * slotsPerFrame + slot) *
+                                                    SYMBOL_PER_SLOT + symbol);
+            record.startPrb = static_cast<uint16_t>(oran::get<oranHeader::startPrbu>(word));
+            uint64_t prbs = oran::get<oranHeader::numPrbu>(word);
+            record.numPrb = static_cast<uint16_t>(prbs ? prbs : 273);
+            if (bodyLength - OranPacket::headerSize != compressor.payloadSize(record.numPrb))
+            {
+                record.errors |= prbError;
+            }
+        }
+        else if (record.messageType == ECPRI_RT_CONTROL)
+        {
+            using control = cplaneHeader::layout;
+            uint64_t word = control::load(body);
+            uint64_t subframe = control::get<cplaneHeader::subframeId>(word);
+            uint64_t slot = control::get<cplaneHeader::slotId>(word);
+            uint64_t sections = control::get<cplaneHeader::numberOfSections>(word);
+            if (subframe >= SUBFRAME_PER_FRAME || slot >= slotsPerFrame || control::get<cplaneHeader::sectionType>(word) != 1 ||
+                control::get<cplaneHeader::udCompHdr>(word) != udCompHdr || ControlPacket::size(sections) != bodyLength)
             {
-                symbolId = (symbolId + 1) % SYMBOL_PER_SLOT; // Increment symbolId after all packets for the current symbol are transmitted
+                record.errors |= malformedError;
+                return;
+            }
+            record.time = static_cast<uint32_t>((control::get<cplaneHeader::frameId>(word) * SUBFRAME_PER_FRAME + subframe) * slotsPerFrame + slot);
 
-                if (symbolId == 0)
+            // The sections have to tile the band
+            uint64_t end = 0;
+            for (uint64_t i = 0; i < sections; i++)
+            {
+                uint64_t section = cplaneSection::layout::load(body + ControlPacket::headerSize + i * ControlPacket::sectionSize);
+                uint64_t prbs = cplaneSection::layout::get<cplaneSection::numPrbc>(section);
+                if (cplaneSection::layout::get<cplaneSection::startPrbc>(section) != end)
                 {
-                    // If symbolId wraps back to 0, increment slotId
-                    slotId = (slotId + 1) % slotsPerFrame;
-
-                    if (slotId == 0)
-                    {
-                        // If slotId wraps back to 0, increment subframeId
-                        subframeId = (subframeId + 1) % 10; // 10 subframes per frame
-
-                        if (subframeId == 0)
-                        {
-                            // If subframeId wraps back to 0, increment frameId
-                            frameId = (frameId + 1) % 256; // 256 frames
-                        }
-                    }
+                    record.errors |= prbError;
                 }
+                end = cplaneSection::layout::get<cplaneSection::startPrbc>(section) + (prbs ? prbs : 273);
+            }
+            if (end < maxNrb)
+            {
+                record.errors |= prbError;
             }
+        }
+        else
+        {
+            record.errors |= malformedError;
+        }
+    }
 
-            ecpriSeqid = (packetNo % 255); // Update sequence ID for eCPRI
+    // Follow a frame in the order of its flow
+    void follow(const frameRecord &record, flowStats &flow, bool controlPlane) const
+    {
+        flow.bytes += record.length;
+        flow.fcsErrors += (record.errors & fcsError) != 0;
+        flow.malformed += (record.errors & malformedError) != 0;
+        flow.prbErrors += (record.errors & prbError) != 0;
+        if (record.errors & malformedError)
+        {
+            return;
+        }
 
-            startPrbu += nrbPerPacket; // Increase startPrbu by nrbPerPacket after each packet.
+        if (record.messageType == ECPRI_RT_CONTROL)
+        {
+            if (flow.cplane > 0 && (record.seqId != (flow.lastControlSeq + 1) % 256))
+            {
+                flow.sequenceErrors++;
+            }
+            if (flow.cplane > 0 && (record.time + slotPeriod - flow.lastControlSlot) % slotPeriod != 1)
+            {
+                flow.timingErrors++;
+            }
+            flow.lastControlSeq = record.seqId;
+            flow.lastControlSlot = record.time;
+            flow.cplane++;
+            return;
+        }
 
-            if (startPrbu >= maxNrb)
-            {                  // Check if startPrbu exceeds MaxNrb.
-                startPrbu = 0; // Reset startPrbu to 0 if we exceed MaxNrb.
+        if (flow.uplane > 0)
+        {
+            if (record.seqId != (flow.lastUplaneSeq + 1) % 255 && !(flow.uplane == 1 && record.seqId == flow.lastUplaneSeq))
+            {
+                flow.sequenceErrors++;
+            }
+            if ((record.time + symbolPeriod - flow.lastSymbol) % symbolPeriod > 1)
+            {
+                flow.timingErrors++;
             }
         }
 
-        // Calculate remaining IFGs to be filled
-        IFGsNo = static_cast<int64_t>(totalTransmisson - size(fullPacket));
-        silentIFGs.assign(IFGsNo, 0x07); // Fill with 0x07 as IFG bytes
+        // Each symbol's packets carry consecutive PRBs, starting over at 0 once the band is covered. The
+        // last packet of a symbol may run past the band when NrbPerPacket does not divide MaxNrb.
+        uint64_t expectedStart = flow.prbEnd >= maxNrb ? 0 : flow.prbEnd;
+        if (record.startPrb != expectedStart)
+        {
+            flow.prbErrors++;
+        }
+        flow.prbEnd = record.startPrb + record.numPrb;
+        flow.pastMaxNrb += flow.prbEnd > maxNrb;
 
-        if (IFGsNo < 0)
+        // The C-plane message of the slot has to be out already
+        if (controlPlane)
         {
-            throw runtime_error("Negative IFGs");
+            uint64_t slot = record.time / SYMBOL_PER_SLOT;
+            uint64_t ahead = (slot + slotPeriod - flow.lastControlSlot) % slotPeriod;
+            if (flow.cplane == 0 || (ahead != 0 && ahead < slotPeriod / 2))
+            {
+                flow.lateControl++;
+            }
         }
 
-        fullPacket.insert(fullPacket.end(), silentIFGs.begin(), silentIFGs.end());
+        flow.lastUplaneSeq = record.seqId;
+        flow.lastSymbol = record.time;
+        flow.uplane++;
+    }
 
-        // Print generation details
-        cout << "Packets/Symbol: " << packetsPERsymbol << endl;
-        cout << "Packets/Slot: " << packetsPERslot << endl;
-        cout << "Packets/Subframe: " << packetsPERsubframe << endl;
-        cout << "Packets/Frame: " << packetsPERframe << endl;
-        cout << "IQ Samples/Packet: " << iqSamplesPERpacket << endl;
-        cout << "Total Bytes: " << totalTransmisson << endl;
-        cout << "Total Generated: " << size(fullPacket) << endl;
-        cout << "Total Frames: " << totalFrames << endl;
-        cout << "Total Packets: " << totalPackets << endl;
-        cout << "Total IQ Samples: " << totalSamples << endl;
-        cout << "Remaining IFGs: " << IFGsNo << endl;
-        cout << "========= Done Generating the Stream =========" << endl;
-        return fullPacket; // Return the generated packet stream
+public:
+    streamValidator(const parseConfigurations &configuration, unsigned Threads)
+        : minIfg(configuration.MinNumOfIFGsPerPacket), maxNrb(configuration.MaxNrb ? configuration.MaxNrb : 273),
+          slotsPerFrame(max<uint64_t>(1, configuration.SCS / SCS_PERIODICITY)), lineRate(configuration.LineRate),
+          expectedBytes(uint64_t(configuration.LineRate) * configuration.CaptureSizeMs * 1000000 / 8),
+          compressor(configuration.CompressionWidth), threads(max(1u, Threads))
+    {
+        udCompHdr = compressor.enabled() ? static_cast<uint8_t>(((compressor.getIqWidth() & 0xF) << 4) | 1) : 0;
+        slotPeriod = 256 * SUBFRAME_PER_FRAME * slotsPerFrame;
+        symbolPeriod = slotPeriod * SYMBOL_PER_SLOT;
     }
 
-    // Helper function to handle default Resource Blocks
-    uint16_t fixRB(uint16_t RB)
+    // Validate `length` bytes of stream and print the report. Returns true when no check failed.
+    bool validate(const uint8_t *stream, uint64_t length)
     {
-        if (RB == 0)
+        auto start = chrono::steady_clock::now();
+
+        // Locate the frames
+        vector<frameRecord> frames;
+        uint64_t syncErrors{0}, truncated{0};
+        uint64_t position = skipIfg(stream, length, 0);
+        while (position < length)
         {
-            return uint16_t(273); // Maximum number of RBs if no value provided
+            if (length - position < preambleSize + 14 || memcmp(stream + position, preamble, preambleSize) != 0)
+            {
+                // Not a frame: skip to the next preamble
+                syncErrors++;
+                position = findPreamble(stream, length, position + 1);
+                continue;
+            }
+            const uint8_t *mac = stream + position + preambleSize;
+            uint64_t header = mac[12] == 0x81 && mac[13] == 0x00 ? 18 : 14;
+            uint64_t frameLength = position + preambleSize + header <= length
+                                       ? header + ((uint64_t(mac[header - 2]) << 8) | mac[header - 1]) + EthernetPacket::fcsSize
+                                       : length;
+            if (position + preambleSize + frameLength > length)
+            {
+                truncated++;
+                break;
+            }
+            uint64_t end = position + preambleSize + frameLength;
+            uint64_t next = skipIfg(stream, length, end);
+            frameRecord record{};
+            record.offset = position;
+            record.length = static_cast<uint32_t>(frameLength);
+            record.gap = static_cast<uint32_t>(min<uint64_t>(next - end, UINT32_MAX));
+            frames.push_back(record);
+            position = next;
         }
-        else
+
+        // Check the frames on all threads
+        vector<thread> workers;
+        uint64_t perThread = (frames.size() + threads - 1) / threads;
+        for (unsigned t = 0; t < threads; t++)
         {
-            return RB;
+            uint64_t first = t * perThread;
+            uint64_t last = min<uint64_t>(frames.size(), first + perThread);
+            workers.emplace_back([&, first, last]
+                                 {
+                                     for (uint64_t i = first; i < last; i++)
+                                     {
+                                         inspect(stream, frames[i]);
+                                     } });
+        }
+        for (auto &t : workers)
+        {
+            t.join();
+        }
+
+        // Follow every flow in stream order
+        bool controlPlane = any_of(frames.begin(), frames.end(), [](const frameRecord &record)
+                                   { return !(record.errors & malformedError) && record.messageType == ECPRI_RT_CONTROL; });
+        map<uint32_t, flowStats> flows; // Keyed by VLAN ID (upper half) and eAxC ID
+        uint64_t ifgErrors{0};
+        for (const frameRecord &record : frames)
+        {
+            ifgErrors += record.gap < minIfg;
+            follow(record, flows[(uint32_t(record.vlanId) << 16) | record.eaxcId], controlPlane);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        // Report
+        bool passed = syncErrors == 0 && truncated == 0 && ifgErrors == 0 && length == expectedBytes;
+        uint64_t uplane{0}, cplane{0}, pastMaxNrb{0};
+        cout << "========= Validation Report =========" << endl;
+        cout << "Stream Bytes: " << length << " (expected " << expectedBytes << ")" << endl;
+        for (auto &entry : flows)
+        {
+            flowStats &flow = entry.second;
+            if (flow.uplane > 0 && flow.prbEnd < maxNrb)
+            {
+                flow.prbErrors++; // The last symbol is incomplete
+            }
+            uplane += flow.uplane;
+            cplane += flow.cplane;
+            pastMaxNrb += flow.pastMaxNrb;
+            passed = passed && flow.fcsErrors == 0 && flow.malformed == 0 && flow.sequenceErrors == 0 && flow.timingErrors == 0 &&
+                     flow.prbErrors == 0 && flow.lateControl == 0;
+        }
+        cout << "Frames: " << frames.size() << " (U-plane " << uplane << ", C-plane " << cplane << ")" << endl;
+        if (pastMaxNrb > 0)
+        {
+            cout << "U-Plane Packets Past PRB " << maxNrb << ": " << pastMaxNrb << " (the last packet of each symbol keeps NrbPerPacket PRBs)" << endl;
+        }
+        cout << "IFG Runs Below " << minIfg << " Bytes: " << ifgErrors << endl;
+        cout << "Sync Errors: " << syncErrors << endl;
+        cout << "Truncated Frames: " << truncated << endl;
+        cout << "Flows: " << flows.size() << endl;
+        cout << left << setw(6) << "VLAN" << setw(8) << "eAxC" << right << setw(10) << "U-Plane" << setw(9) << "C-Plane" << setw(13) << "Bytes"
+             << setw(9) << "Gbps" << setw(6) << "FCS" << setw(10) << "Malformed" << setw(7) << "SeqId" << setw(8) << "Timing"
+             << setw(6) << "PRB" << setw(8) << "LateCP" << endl;
+        for (const auto &entry : flows)
+        {
+            const flowStats &flow = entry.second;
+            uint16_t vlanId = static_cast<uint16_t>(entry.first >> 16);
+            ostringstream eaxc, gbps;
+            eaxc << "0x" << hex << setw(4) << setfill('0') << (entry.first & 0xFFFF);
+            gbps << fixed << setprecision(3) << (length ? double(flow.bytes) * lineRate / length : 0.0);
+            cout << left << setw(6) << (vlanId == 0xFFFF ? string("-") : to_string(vlanId)) << setw(8) << eaxc.str() << right
+                 << setw(10) << flow.uplane << setw(9) << flow.cplane << setw(13) << flow.bytes << setw(9) << gbps.str()
+                 << setw(6) << flow.fcsErrors << setw(10) << flow.malformed << setw(7) << flow.sequenceErrors << setw(8)
+                 << flow.timingErrors << setw(6) << flow.prbErrors << setw(8) << flow.lateControl << endl;
         }
+        ostringstream rate;
+        rate << fixed << setprecision(2) << (seconds > 0 ? length / seconds / 1e9 : 0.0);
+        cout << "Validated in " << seconds << " s (" << rate.str() << " GB/s of stream)" << endl;
+        cout << "Validation: " << (passed ? "PASSED" : "FAILED") << endl;
+        cout << "========= Done Validating =========" << endl;
+        return passed;
     }
 };
 
-// Function to export the generated packet stream to a text file
-void writePacketStreamToFile(const vector<uint8_t> &fullPacketStream, const string &fileName)
+// Validate a capture written by the generator: the packets.txt hex layout, or raw bytes (--format bin),
+// told apart by the first byte. The file is mapped; hex text is decoded on `threads` threads, a share of
+// whole lines each, into a buffer that is then validated.
+bool validateCapture(const string &fileName, const parseConfigurations &configuration, unsigned threads)
 {
-    cout << "========= Start Exporting the Stream =========" << endl;
+    cout << "========= Validating " << fileName << " =========" << endl;
+    mappedFile capture(fileName);
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(capture.data());
+    streamValidator validator{configuration, threads};
+    if (capture.size() == 0 || bytes[0] == 0xfb || bytes[0] == 0x07)
+    {
+        return validator.validate(bytes, capture.size());
+    }
+    if (rleExpander::isContainer(bytes, capture.size()))
+    {
+        memorySink stream;
+        rleExpander::expand(bytes, capture.size(), stream);
+        return validator.validate(stream.getStream().data(), stream.getStream().size());
+    }
 
-    // Create and open a text file to store the generated packet stream
-    ofstream MyFile(fileName);
+    auto start = chrono::steady_clock::now();
+    uint64_t chars = capture.size();
+    uint64_t length = hexDecoder::decodedSize(chars);
+    unique_ptr<uint8_t[]> stream(new uint8_t[length + 1]); // Not zeroed: every byte is decoded
+    uint64_t lines = chars / hexDecoder::lineChars;
+    uint64_t perThread = (lines + threads - 1) / threads;
+    atomic<bool> layout{true};
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        uint64_t first = min(lines, t * perThread);
+        uint64_t last = t + 1 == threads ? lines : min(lines, first + perThread);
+        uint64_t count = (last - first) * hexDecoder::lineChars + (t + 1 == threads ? chars % hexDecoder::lineChars : 0);
+        workers.emplace_back([&, first, count]
+                             {
+                                 if (!hexDecoder::decode(capture.data() + first * hexDecoder::lineChars, count, stream.get() + 4 * first))
+                                 {
+                                     layout = false;
+                                 } });
+    }
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+    if (!layout)
+    {
+        // Not the exact packets.txt layout: decode whatever hex text it is
+        length = hexDecoder::decodeLoose(capture.data(), chars, stream.get());
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    ostringstream rate;
+    rate << fixed << setprecision(2) << (seconds > 0 ? chars / seconds / 1e9 : 0.0);
+    cout << "Decoded " << chars << " hex characters into " << length << " bytes in " << seconds << " s (" << rate.str() << " GB/s)" << endl;
+    return validator.validate(stream.get(), length);
+}
 
-    cout << " Exporting the stream to .\\" << fileName << endl;
+// Expand an RLE container back into the stream, written in `format` (hex, bin or pcapng) to `outputFile`
+void expandContainer(const string &fileName, const string &outputFile, const string &format, const string &sink, unsigned exportThreads)
+{
+    cout << "========= Expanding " << fileName << " =========" << endl;
+    mappedFile container(fileName);
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(container.data());
+    rleExpander::containerHeader header = rleExpander::readHeader(bytes, container.size());
+    auto start = chrono::steady_clock::now();
 
-    // Counter to insert a line break after every 4 bytes
-    uint8_t counter{0};
+    unique_ptr<streamSink> output;
+    if (format == "pcapng")
+    {
+        output = make_unique<pcapngSink>(outputFile, header.lineRate);
+    }
+#ifndef _WIN32
+    else if (sink == "mmap")
+    {
+        output = make_unique<mmapSink>(outputFile, format == "bin");
+    }
+#endif
+    else if (sink == "hash")
+    {
+        output = make_unique<hashSink>();
+    }
+    else if (sink == "null")
+    {
+        output = make_unique<nullSink>();
+    }
+    else
+    {
+        output = make_unique<fileSink>(outputFile, format == "bin", exportThreads);
+    }
+    uint64_t length = rleExpander::expand(bytes, container.size(), *output);
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    ostringstream rate;
+    rate << fixed << setprecision(2) << (seconds > 0 ? length / seconds / 1e9 : 0.0);
+    cout << "Expanded " << container.size() << " bytes into " << length << " stream bytes in " << seconds << " s (" << rate.str()
+         << " GB/s of stream)" << endl;
+}
+
+// Command line options selecting where the generated stream goes
+struct runOptions
+{
+    string configFile{"second_milestone.txt"}; // Configuration file to parse
+    string sink{"file"};                       // file, mmap, memory, null, hash or shm
+    string outputFile{"packets.txt"};          // Output file of the file, mmap and memory sinks, ring name of the shm sink
+    string format{"hex"};                      // hex (packets.txt layout), bin (raw bytes), pcapng or rle
+    unsigned threads{1};                       // Generation threads (0 = one per hardware thread)
+    unsigned exportThreads{1};                 // Hex export threads (0 = one per hardware thread)
+    string benchmarkFile;                      // Run the benchmark suite and write its results here
+    string statsFile;                          // Time every stage of the run and write the counters here
+    string consumeRing;                        // Consume the frames of this shared-memory ring instead of generating
+    string validateFile;                       // Validate this capture instead of generating
+    string sweepFile;                          // Generate every combination of this sweep file
+    string segmentSize;                        // Rotate the file sink output into segments of this size or duration
+    string expandFile;                         // Expand this RLE container instead of generating
+    uint64_t shmTimeout{SHM_PEER_TIMEOUT};     // Seconds either side of the shm ring waits for a silent peer (0 = forever)
+    bool plan{false};                          // Only describe the stream, without building it
+    bool selfTest{false};                      // Check the optimized kernels against reference versions
+};
 
-    // Loop through the fullPacketStream and write each byte to the text file
-    for (auto byte : fullPacketStream)
+// Parse "--option value" pairs from the command line
+runOptions parseCommandLine(int argc, char *argv[])
+{
+    runOptions options;
+    bool outputGiven{false};
+    for (int i = 1; i < argc; i++)
     {
-        // Write each byte as a 2-digit hex value, ensuring leading zeros
-        MyFile << hex << setw(2) << setfill('0') << static_cast<uint64_t>(byte);
+        string option = argv[i];
+        // Options without a value
+        if (option == "--plan")
+        {
+            options.plan = true;
+            continue;
+        }
+        if (option == "--self-test")
+        {
+            options.selfTest = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            throw runtime_error("Missing value for option " + option);
+        }
+        string value = argv[++i];
 
-        // Insert a newline after every 4 bytes written to the file
-        if (counter == 3)
+        if (option == "--config")
+        {
+            options.configFile = value;
+        }
+        else if (option == "--sink")
+        {
+            if (value != "file" && value != "mmap" && value != "memory" && value != "null" && value != "hash" && value != "shm")
+            {
+                throw runtime_error("Unknown sink " + value + " (expected file, mmap, memory, null, hash or shm)");
+            }
+#ifdef _WIN32
+            if (value == "mmap" || value == "shm")
+            {
+                throw runtime_error("The " + value + " sink is only available on POSIX systems");
+            }
+#endif
+            options.sink = value;
+        }
+        else if (option == "--output")
+        {
+            options.outputFile = value;
+            outputGiven = true;
+        }
+        else if (option == "--format")
+        {
+            if (value != "hex" && value != "bin" && value != "pcapng" && value != "rle")
+            {
+                throw runtime_error("Unknown format " + value + " (expected hex, bin, pcapng or rle)");
+            }
+            options.format = value;
+        }
+        else if (option == "--threads")
+        {
+            options.threads = static_cast<unsigned>(convertIntoInteger(value));
+        }
+        else if (option == "--export-threads")
+        {
+#ifdef _WIN32
+            throw runtime_error("--export-threads is only available on POSIX systems");
+#endif
+            options.exportThreads = static_cast<unsigned>(convertIntoInteger(value));
+            if (options.exportThreads == 0)
+            {
+                options.exportThreads = max(1u, thread::hardware_concurrency());
+            }
+        }
+        else if (option == "--benchmark")
+        {
+            options.benchmarkFile = value;
+        }
+        else if (option == "--stats")
+        {
+            options.statsFile = value;
+        }
+        else if (option == "--segment")
+        {
+            options.segmentSize = value;
+        }
+        else if (option == "--sweep")
+        {
+            options.sweepFile = value;
+        }
+        else if (option == "--validate")
+        {
+            options.validateFile = value;
+        }
+        else if (option == "--expand")
+        {
+            options.expandFile = value;
+        }
+        else if (option == "--shm-timeout")
+        {
+            options.shmTimeout = convertIntoInteger(value);
+        }
+        else if (option == "--consume")
         {
-            MyFile << endl;
-            counter = 0; // Reset the counter
+#ifdef _WIN32
+            throw runtime_error("--consume is only available on POSIX systems");
+#endif
+            options.consumeRing = value;
         }
         else
         {
-            counter++;
+            throw runtime_error("Unknown option " + option);
         }
     }
-    cout << "========= Done Exporting the Stream =========" << endl;
 
-    // Close the file after writing is done
-    MyFile.close();
+    // A capture gets its own default name rather than packets.txt
+    if (options.format == "pcapng" && !outputGiven)
+    {
+        options.outputFile = "packets.pcapng";
+    }
+    if (options.format == "rle" && !outputGiven)
+    {
+        options.outputFile = "packets.rle";
+    }
+    if (options.sink == "shm" && !outputGiven)
+    {
+        options.outputFile = "/oran_stream";
+    }
+    if (!options.segmentSize.empty() && options.sink != "file")
+    {
+        throw runtime_error("--segment applies to the file sink only");
+    }
+    if (!options.segmentSize.empty() && options.format == "rle")
+    {
+        throw runtime_error("--segment writes hex, bin or pcapng segments");
+    }
+    if (!options.expandFile.empty() && options.format == "rle")
+    {
+        throw runtime_error("--expand writes hex, bin or pcapng");
+    }
+    return options;
 }
 
 //==================================================================================//
-int main()
+int main(int argc, char *argv[])
 {
-    // Vector to store the full packet stream generated later
-    vector<uint8_t> fullPacketStream;
+    runOptions options = parseCommandLine(argc, argv);
+
+#ifndef _WIN32
+    if (!options.consumeRing.empty())
+    {
+        return consumeShmRing(options.consumeRing, options.shmTimeout) ? 0 : 1;
+    }
+#endif
+
+    if (options.selfTest)
+    {
+        return selfTest{}.run() ? 0 : 1;
+    }
 
-    // Parse configuration file "second_milestone.txt" to extract Ethernet settings
-    parseConfigurations configuration("second_milestone.txt");
+    if (!options.sweepFile.empty())
+    {
+        // One generation per combination of the sweep file, --threads combinations at a time
+        parameterSweep sweep{options.sweepFile, options.configFile, options.outputFile, options.format, options.sink};
+        return sweep.run(options.threads ? options.threads : max(1u, thread::hardware_concurrency())) ? 0 : 1;
+    }
+
+    if (!options.expandFile.empty())
+    {
+        expandContainer(options.expandFile, options.outputFile, options.format, options.sink, options.exportThreads);
+        return 0;
+    }
+
+    if (!options.validateFile.empty())
+    {
+        // Check a capture against the configuration that produced it (the IQ files are not needed)
+        parseConfigurations configuration{options.configFile, {}, false};
+        unsigned threads = options.threads ? options.threads : max(1u, thread::hardware_concurrency());
+        return validateCapture(options.validateFile, configuration, threads) ? 0 : 1;
+    }
+
+    if (!options.benchmarkFile.empty())
+    {
+        // Time every stage and the whole generator over a grid of line rates, PRBs per packet and payloads
+        benchmarkSuite suite;
+        suite.runMicro(30);
+        suite.runMicro(100);
+        suite.runMacro(options.configFile, {10, 25, 100, 200, 400}, {10, 30, 0}, options.threads ? options.threads : max(1u, thread::hardware_concurrency()));
+        suite.writeJson(options.benchmarkFile);
+        return 0;
+    }
+
+    if (!options.statsFile.empty())
+    {
+        stageStats::enable();
+    }
+
+    // Parse the configuration file (default "second_milestone.txt") to extract Ethernet and ORAN settings
+    parseConfigurations configuration = [&]
+    {
+        scopedStage timer{stage::configParse};
+        return parseConfigurations(options.configFile, {}, !options.plan); // A plan does not read the IQ files
+    }();
 
     // Create packetStreaming object using configuration data and payload
     packetStreaming packetStreaming{configuration};
+    packetStreaming.setThreads(options.threads);
+    if (options.plan)
+    {
+        // Size the stream and count its frames without building a byte of it
+        streamDescriptor stream = packetStreaming.describeStream();
+        stream.print();
+        return stream.idleBytes < 0 ? 1 : 0;
+    }
+    auto generationStart = chrono::steady_clock::now();
 
-    // Construct the full packet stream with bursts and IFGs
-    fullPacketStream = packetStreaming.generateStream();
+    if (options.sink == "memory")
+    {
+        // Construct the full packet stream in memory, then write it to the output file
+        vector<uint8_t> fullPacketStream = packetStreaming.generateStream();
+        if (options.format == "pcapng")
+        {
+            scopedStage timer{stage::exportStream, fullPacketStream.size()};
+            pcapngSink capture{options.outputFile, configuration.LineRate};
+            capture.begin(fullPacketStream.size());
+            capture.write(fullPacketStream.data(), fullPacketStream.size());
+            capture.end();
+        }
+        else if (options.format == "rle")
+        {
+            scopedStage timer{stage::exportStream, fullPacketStream.size()};
+            rleSink container{options.outputFile, configuration.LineRate};
+            container.begin(fullPacketStream.size());
+            container.write(fullPacketStream.data(), fullPacketStream.size());
+            container.end();
+        }
+        else if (options.format == "bin")
+        {
+            scopedStage timer{stage::exportStream, fullPacketStream.size()};
+            fileSink file{options.outputFile, true};
+            file.begin(fullPacketStream.size());
+            file.write(fullPacketStream.data(), fullPacketStream.size());
+            file.end();
+        }
+        else
+        {
+            writePacketStreamToFile(fullPacketStream, options.outputFile, options.exportThreads);
+        }
+    }
+    else if (!options.segmentSize.empty())
+    {
+        // Rotate the output into segment files written by a background thread
+        segmentSink segments{options.outputFile, options.format, configuration.LineRate,
+                             segmentSink::parseSize(options.segmentSize, configuration.LineRate)};
+        packetStreaming.generateStream(segments);
+    }
+    else if ((options.sink == "file" || options.sink == "mmap") && options.format == "pcapng")
+    {
+        // Stream the frames straight into a pcapng capture
+        pcapngSink capture{options.outputFile, configuration.LineRate};
+        packetStreaming.generateStream(capture);
+    }
+    else if ((options.sink == "file" || options.sink == "mmap") && options.format == "rle")
+    {
+        // Store the frames and the lengths of the IFG runs only
+        rleSink container{options.outputFile, configuration.LineRate};
+        packetStreaming.generateStream(container);
+    }
+    else if (options.sink == "file")
+    {
+        // Stream the packets straight to the output file with bounded memory
+        fileSink file{options.outputFile, options.format == "bin", options.exportThreads};
+        packetStreaming.generateStream(file);
+    }
+#ifndef _WIN32
+    else if (options.sink == "mmap" && options.format != "pcapng")
+    {
+        // Generate straight into the memory-mapped output file
+        mmapSink mapped{options.outputFile, options.format == "bin"};
+        packetStreaming.generateStream(mapped);
+    }
+    else if (options.sink == "shm")
+    {
+        // Publish the frames to a consumer process through a shared-memory ring
+        shmRingSink ring{options.outputFile, configuration.LineRate, options.shmTimeout};
+        packetStreaming.generateStream(ring);
+    }
+#endif
+    else if (options.sink == "hash")
+    {
+        hashSink hash;
+        packetStreaming.generateStream(hash);
+    }
+    else
+    {
+        nullSink discard;
+        packetStreaming.generateStream(discard);
+    }
 
-    // Call the new function to write the full packet stream to "packets.txt"
-    writePacketStreamToFile(fullPacketStream, "packets.txt");
+    if (!options.statsFile.empty())
+    {
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - generationStart).count();
+        stageStats::writeJson(options.statsFile, options.configFile, configuration.LineRate,
+                              packetStreaming.getTotalPackets() + packetStreaming.getControlMessages(),
+                              packetStreaming.getGeneratedBytes(), seconds);
+    }
 
     return 0;
 }